@@ -1,6 +1,7 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
@@ -24,6 +25,18 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* A thread blocked in timer_sleep(). */
+struct sleeper
+  {
+    struct list_elem elem;      /* Element in sleep_list. */
+    int64_t wakeup;             /* Tick at which to wake. */
+    struct semaphore sema;      /* Upped at WAKEUP. */
+  };
+
+/* Sleeping threads, in order of wakeup tick.  Accessed with
+   interrupts off, since timer_interrupt() wakes them. */
+static struct list sleep_list;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -37,6 +50,7 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  list_init (&sleep_list);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -84,16 +98,35 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns true if sleeper A wakes before sleeper B. */
+static bool
+wakes_earlier (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  const struct sleeper *a = list_entry (a_, struct sleeper, elem);
+  const struct sleeper *b = list_entry (b_, struct sleeper, elem);
+  return a->wakeup < b->wakeup;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.  The thread is blocked, not spinning, until
+   timer_interrupt() wakes it. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct sleeper s;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  s.wakeup = timer_ticks () + ticks;
+  sema_init (&s.sema, 0);
+  old_level = intr_disable ();
+  list_insert_ordered (&sleep_list, &s.elem, wakes_earlier, NULL);
+  intr_set_level (old_level);
+  sema_down (&s.sema);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -172,6 +205,16 @@ timer_interrupt (struct intr_frame *args UNUSED)
 {
   ticks++;
   thread_tick ();
+
+  while (!list_empty (&sleep_list))
+    {
+      struct sleeper *s = list_entry (list_front (&sleep_list),
+                                      struct sleeper, elem);
+      if (s->wakeup > ticks)
+        break;
+      list_pop_front (&sleep_list);
+      sema_up (&s->sema);
+    }
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -1,219 +1,594 @@
 #include "filesys/block_cache.h"
 #include "filesys/filesys.h"
 #include "devices/timer.h"
-#include "threads/synch.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <debug.h>
+#include <round.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
-#define CACHE_SIZE 64
+/* Number of sectors in the cache.  Set by -bc. */
+size_t block_cache_size = CACHE_SIZE;
+
+/* Sector-to-slot index.  Open addressing with linear probing.  The
+   table is sized at init to the smallest power of two that is at
+   least twice the cache size, so probe sequences stay short however
+   large the cache is. */
+static int index_bits;
+static size_t index_mask;
+#define INDEX_EMPTY -1
+
+struct block_cache_index_entry
+  {
+    block_sector_t sector;
+    int slot;                   /* Index into cache_items or INDEX_EMPTY. */
+  };
+
+/* The write-behind thread flushes dirty blocks at least this often,
+   bounding how much data a crash can lose, and sooner once more than
+   DIRTY_HIGH_WATER blocks are dirty. */
+#define WRITE_BEHIND_INTERVAL TIMER_FREQ
+#define DIRTY_HIGH_WATER ((int) block_cache_size / 4)
+
+/* Sectors waiting to be read in by the read-ahead thread.  Requests
+   that arrive while the queue is full are dropped. */
+#define READ_AHEAD_QUEUE_SIZE 32
 
 struct block_cache_entry
   {
-    struct lock access_lock;
-    struct lock timestamp_lock;
-    int64_t last_access;
+    struct rw_lock access_lock;  /* Shared for reads, exclusive to modify. */
+    bool accessed;              /* Reference bit for clock eviction. */
     bool occupied;
     block_sector_t sector;
     bool dirty;
+    bool prefetched;            /* Read ahead and not yet used. */
     void *data;
   };
 
-static struct block_cache_entry cache_items[CACHE_SIZE];
+static struct block_cache_entry *cache_items;
+static uint8_t (*cache_data)[BLOCK_SECTOR_SIZE];
+static struct block_cache_index_entry *cache_index;
 static struct lock mod_lock;
 
+/* Scratch space for block_cache_write_out(), which it serializes. */
+static size_t *write_out_order;
+static struct lock write_out_lock;
+static size_t clock_hand;       /* Next slot examined for eviction. */
+
+static block_sector_t read_ahead_queue[READ_AHEAD_QUEUE_SIZE];
+static size_t read_ahead_head;  /* Next request to service. */
+static size_t read_ahead_cnt;   /* Number of queued requests. */
+static struct lock read_ahead_lock;
+static struct condition read_ahead_cond;
+
+static thread_func read_ahead_daemon NO_RETURN;
+
+static int dirty_cnt;           /* Number of dirty entries. */
+static bool flush_pending;      /* flush_sema is up or about to be. */
+static struct semaphore flush_sema;  /* Wakes the write-behind thread. */
+
+static thread_func write_behind_daemon NO_RETURN;
+static thread_func flush_timer NO_RETURN;
+static void request_flush (void);
+
 int missCnt;
 int hitCnt;
+int probeCnt;
+int prefetchCnt;
+int prefetchHitCnt;
 
 void
 block_cache_init (void)
 {
+  size_t data_pages = DIV_ROUND_UP (block_cache_size * BLOCK_SECTOR_SIZE,
+                                    PGSIZE);
+
+  ASSERT (block_cache_size > 0);
+  for (index_bits = 1; ((size_t) 1 << index_bits) < 2 * block_cache_size;
+       index_bits++)
+    continue;
+  index_mask = ((size_t) 1 << index_bits) - 1;
+
+  cache_items = malloc (block_cache_size * sizeof *cache_items);
+  cache_data = palloc_get_multiple (0, data_pages);
+  cache_index = malloc ((index_mask + 1) * sizeof *cache_index);
+  write_out_order = malloc (block_cache_size * sizeof *write_out_order);
+  if (cache_items == NULL || cache_data == NULL || cache_index == NULL
+      || write_out_order == NULL)
+    PANIC ("couldn't allocate a %zu-sector buffer cache", block_cache_size);
+  lock_init (&write_out_lock);
+
   missCnt = 0;
   hitCnt = 0;
+  probeCnt = 0;
+  prefetchCnt = 0;
+  prefetchHitCnt = 0;
+  lock_init (&mod_lock);
+  clock_hand = 0;
+  dirty_cnt = 0;
+  flush_pending = false;
+  sema_init (&flush_sema, 0);
   size_t i;
-  for (i = 0; i < CACHE_SIZE; i++)
+  for (i = 0; i <= index_mask; i++)
+    cache_index[i].slot = INDEX_EMPTY;
+  for (i = 0; i < block_cache_size; i++)
     {
-      lock_init (&mod_lock);
-      lock_init (&cache_items[i].access_lock);
-      lock_init (&cache_items[i].timestamp_lock);
-      cache_items[i].last_access = 0;
+      rw_lock_init (&cache_items[i].access_lock);
+      cache_items[i].accessed = false;
       cache_items[i].occupied = false;
       cache_items[i].dirty = false;
-      cache_items[i].data = malloc (BLOCK_SECTOR_SIZE);
+      cache_items[i].prefetched = false;
+      cache_items[i].data = cache_data[i];
     }
+
+  read_ahead_head = 0;
+  read_ahead_cnt = 0;
+  lock_init (&read_ahead_lock);
+  cond_init (&read_ahead_cond);
+  thread_create ("read-ahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+  thread_create ("write-behind", PRI_DEFAULT, write_behind_daemon, NULL);
+  thread_create ("flush-timer", PRI_DEFAULT, flush_timer, NULL);
 }
 
 void
 block_cache_done (void)
 {
   block_cache_write_out ();
-  size_t i;
-  for (i = 0; i < CACHE_SIZE; i++)
-    free (cache_items[i].data);
 }
 
+/* Sets the dirty bit of cache entry INDEX and keeps dirty_cnt in
+   step.  Setting it requires INDEX's access_lock for writing;
+   clearing it only requires that no writer can get in, so write-back
+   may hold the lock for reading. */
+static void
+set_dirty (size_t index, bool dirty)
+{
+  ASSERT (!dirty || rw_lock_held_for_write (&cache_items[index].access_lock));
+
+  enum intr_level old_level = intr_disable ();
+  if (cache_items[index].dirty != dirty)
+    {
+      dirty_cnt += dirty ? 1 : -1;
+      cache_items[index].dirty = dirty;
+      if (dirty_cnt >= DIRTY_HIGH_WATER)
+        request_flush ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Writes every dirty block back to disk.  Blocks are written in
+   ascending sector order so that the disk head makes one sweep. */
 void
 block_cache_write_out (void)
 {
-  size_t i;
-  for (i = 0; i < CACHE_SIZE; i++)
+  size_t *order = write_out_order;
+  size_t cnt = 0;
+  size_t i, j;
+
+  lock_acquire (&write_out_lock);
+
+  /* Collect dirty slots, insertion-sorted by sector.  Entries may
+     change under us; each one is rechecked under its lock below. */
+  for (i = 0; i < block_cache_size; i++)
     {
       if (!cache_items[i].occupied) continue;
       if (!cache_items[i].dirty) continue;
-      lock_acquire (&cache_items[i].access_lock);
+      for (j = cnt; j > 0
+           && cache_items[order[j - 1]].sector > cache_items[i].sector; j--)
+        order[j] = order[j - 1];
+      order[j] = i;
+      cnt++;
+    }
+
+  for (j = 0; j < cnt; j++)
+    {
+      i = order[j];
+      rw_lock_acquire_read (&cache_items[i].access_lock);
 
-      if (!cache_items[i].dirty)
+      if (!cache_items[i].occupied || !cache_items[i].dirty)
         {
-          lock_release (&cache_items[i].access_lock);
+          rw_lock_release_read (&cache_items[i].access_lock);
           continue;
         }
-      cache_items[i].dirty = false;
+      set_dirty (i, false);
       block_write (fs_device, cache_items[i].sector, cache_items[i].data);
 
-      lock_release (&cache_items[i].access_lock);
+      rw_lock_release_read (&cache_items[i].access_lock);
     }
+
+  lock_release (&write_out_lock);
 }
 
+/* Wakes the write-behind thread, unless a wakeup is already on its
+   way.  May be called with interrupts off. */
 static void
-update_timestamp (size_t index)
+request_flush (void)
 {
-  lock_acquire (&cache_items[index].timestamp_lock);
-  cache_items[index].last_access = timer_ticks ();
-  lock_release (&cache_items[index].timestamp_lock);
+  enum intr_level old_level = intr_disable ();
+  if (!flush_pending)
+    {
+      flush_pending = true;
+      sema_up (&flush_sema);
+    }
+  intr_set_level (old_level);
 }
 
-static int64_t
-get_timestamp (size_t index)
+/* Flushes dirty blocks whenever asked: when more than
+   DIRTY_HIGH_WATER blocks are dirty, when eviction finds only dirty
+   victims, and every WRITE_BEHIND_INTERVAL ticks.  Blocked the rest
+   of the time, so misses rarely have to write out a victim before
+   reading and the thread costs nothing while the cache is clean. */
+static void
+write_behind_daemon (void *aux UNUSED)
 {
-  lock_acquire (&cache_items[index].timestamp_lock);
-  int64_t result = cache_items[index].last_access;
-  lock_release (&cache_items[index].timestamp_lock);
-  return result;
+  while (true)
+    {
+      sema_down (&flush_sema);
+      flush_pending = false;
+      block_cache_write_out ();
+    }
 }
 
+/* Asks for a flush every WRITE_BEHIND_INTERVAL ticks while any
+   block is dirty, bounding how much data a crash can lose. */
+static void
+flush_timer (void *aux UNUSED)
+{
+  while (true)
+    {
+      timer_sleep (WRITE_BEHIND_INTERVAL);
+      if (dirty_cnt > 0)
+        request_flush ();
+    }
+}
+
+/* Returns the home position of SECTOR in cache_index. */
 static size_t
-select_for_eviction (void)
+index_hash (block_sector_t sector)
 {
-  size_t earliest_index = CACHE_SIZE;
+  return (sector * 2654435761u) >> (32 - index_bits);
+}
 
+/* Returns the cache slot holding SECTOR according to the index, or
+   INDEX_EMPTY if there is none.  May be called without mod_lock, in
+   which case the answer is only a hint and must be verified under the
+   entry's access_lock. */
+static int
+index_lookup (block_sector_t sector)
+{
   size_t i;
-  for (i = 0; i < CACHE_SIZE; i++)
+  for (i = index_hash (sector); ; i = (i + 1) & index_mask)
+    {
+      probeCnt += 1;
+      int slot = cache_index[i].slot;
+      if (slot == INDEX_EMPTY)
+        return INDEX_EMPTY;
+      if (cache_index[i].sector == sector)
+        return slot;
+    }
+}
+
+/* Records that SECTOR lives in cache slot SLOT.  Must hold mod_lock. */
+static void
+index_insert (block_sector_t sector, int slot)
+{
+  ASSERT (lock_held_by_current_thread (&mod_lock));
+
+  size_t i = index_hash (sector);
+  while (cache_index[i].slot != INDEX_EMPTY)
+    i = (i + 1) & index_mask;
+  cache_index[i].sector = sector;
+  cache_index[i].slot = slot;
+}
+
+/* Forgets SECTOR, shifting later members of its probe run back so
+   that no tombstones are needed.  Must hold mod_lock. */
+static void
+index_remove (block_sector_t sector)
+{
+  ASSERT (lock_held_by_current_thread (&mod_lock));
+
+  size_t i = index_hash (sector);
+  while (cache_index[i].sector != sector || cache_index[i].slot == INDEX_EMPTY)
+    {
+      ASSERT (cache_index[i].slot != INDEX_EMPTY);
+      i = (i + 1) & index_mask;
+    }
+
+  size_t j = i;
+  while (true)
     {
-      if (!cache_items[i].occupied) return i;
-      if (earliest_index == CACHE_SIZE ||
-          get_timestamp(i) < get_timestamp(earliest_index)) 
-        earliest_index = i;
+      j = (j + 1) & index_mask;
+      if (cache_index[j].slot == INDEX_EMPTY)
+        break;
+
+      /* Leave the entry at J alone if its home lies cyclically in
+         (I, J]; otherwise it can move into the hole at I. */
+      size_t home = index_hash (cache_index[j].sector);
+      if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+        continue;
+      cache_index[i] = cache_index[j];
+      i = j;
     }
+  cache_index[i].slot = INDEX_EMPTY;
+}
 
-  return earliest_index;
+/* Picks a slot to hold a new sector using the clock algorithm:
+   sweep from the hand, giving each recently accessed slot a second
+   chance by clearing its reference bit.  Free slots are taken
+   immediately.  Dirty slots are passed over for two full sweeps, and
+   the write-behind thread is asked to clean them, so that a miss
+   normally does not have to write before it reads.  Slots that are
+   locked, including blocks pinned by block_cache_get(), are never
+   chosen, so eviction cannot wait on a lock while holding mod_lock.
+   Returns the slot with its access_lock held for writing, or
+   block_cache_size if every slot stayed busy for three sweeps, in
+   which case the caller should drop mod_lock and retry.  Must hold
+   mod_lock. */
+static size_t
+select_for_eviction (void)
+{
+  ASSERT (lock_held_by_current_thread (&mod_lock));
+
+  size_t steps;
+  for (steps = 0; steps < 3 * block_cache_size; steps++)
+    {
+      size_t i = clock_hand;
+      clock_hand = (clock_hand + 1) % block_cache_size;
+
+      if (cache_items[i].occupied)
+        {
+          if (cache_items[i].accessed)
+            {
+              cache_items[i].accessed = false;
+              continue;
+            }
+          if (cache_items[i].dirty && steps < 2 * block_cache_size)
+            {
+              request_flush ();
+              continue;
+            }
+        }
+      if (rw_lock_try_acquire_write (&cache_items[i].access_lock))
+        return i;
+    }
+  return block_cache_size;
 }
 
+/* Releases cache entry INDEX's access_lock, held for writing if
+   EXCLUSIVE or for reading otherwise. */
+static void
+access_release (size_t index, bool exclusive)
+{
+  if (exclusive)
+    rw_lock_release_write (&cache_items[index].access_lock);
+  else
+    rw_lock_release_read (&cache_items[index].access_lock);
+}
+
+/* Finds SECTOR in the cache, reading it in if necessary, and returns
+   its slot with the access_lock held.  The lock is held for writing
+   if *EXCLUSIVE is true on entry or if the block had to be read in,
+   in which case *EXCLUSIVE is set to true; otherwise it is held for
+   reading.  PREFETCH lookups come from the read-ahead thread and are
+   counted separately from demand hits and misses. */
 static size_t
-find_and_access (block_sector_t sector)
+find_and_access (block_sector_t sector, bool prefetch, bool *exclusive)
 {
   size_t index;
 
   while (true)
     {
       // If block is already in cache, find it and lock it.
-      hitCnt += 1;
-      for (index = 0; index < CACHE_SIZE; index++)
+      if (!prefetch)
+        hitCnt += 1;
+      int slot = index_lookup (sector);
+      if (slot != INDEX_EMPTY)
         {
-          if (!cache_items[index].occupied) continue;
-          if (cache_items[index].sector != sector) continue;
-
-          lock_acquire (&cache_items[index].access_lock);
+          index = slot;
+          if (*exclusive)
+            rw_lock_acquire_write (&cache_items[index].access_lock);
+          else
+            rw_lock_acquire_read (&cache_items[index].access_lock);
 
           // Verify that it's not a false positive.
-          if (cache_items[index].sector == sector)
+          if (cache_items[index].occupied
+              && cache_items[index].sector == sector)
             {
-              update_timestamp (index);
+              cache_items[index].accessed = true;
+              if (!prefetch && cache_items[index].prefetched)
+                {
+                  cache_items[index].prefetched = false;
+                  prefetchHitCnt += 1;
+                }
               return index;
             }
-          else
-            lock_release (&cache_items[index].access_lock);
+          access_release (index, *exclusive);
         }
 
       lock_acquire (&mod_lock);
 
       // Check if false negative. If so, will probably find the element next
       // iteration
-      for (index = 0; index < CACHE_SIZE; index++)
-        {
-          if (!cache_items[index].occupied) continue;
-          if (cache_items[index].sector == sector) break;
-        }
-      if (index != CACHE_SIZE)
+      if (index_lookup (sector) != INDEX_EMPTY)
         {
           lock_release (&mod_lock);
           continue;
         }
 
-      hitCnt -= 1;
-      missCnt += 1;
       // Now the block is definitely not in the cache. Pick block to replace
       index = select_for_eviction ();
-      if (index != CACHE_SIZE)
+      if (index == block_cache_size)
+        {
+          // Every slot is busy.  Let the holders run, without blocking
+          // everyone else's misses behind mod_lock, then look again.
+          if (!prefetch)
+            hitCnt -= 1;
+          lock_release (&mod_lock);
+          thread_yield ();
+          continue;
+        }
+
+      if (prefetch)
+        prefetchCnt += 1;
+      else
         {
-          lock_acquire (&cache_items[index].access_lock);
+          hitCnt -= 1;
+          missCnt += 1;
+        }
+      *exclusive = true;
 
-          bool old_occupied = cache_items[index].occupied;
-          block_sector_t old_sector = cache_items[index].sector;
-          cache_items[index].occupied = true;
-          cache_items[index].sector = sector;
-          update_timestamp (index); // Before releasing mod lock for performance
+      bool old_occupied = cache_items[index].occupied;
+      block_sector_t old_sector = cache_items[index].sector;
+      cache_items[index].occupied = true;
+      cache_items[index].sector = sector;
+      if (old_occupied)
+        index_remove (old_sector);
+      index_insert (sector, index);
+      cache_items[index].accessed = true;
 
-          // Done modifying list structure
-          lock_release (&mod_lock);
+      // Done modifying list structure
+      lock_release (&mod_lock);
 
-          // Write out old block, read in new block
-          if (old_occupied && cache_items[index].dirty)
-            block_write (fs_device, old_sector, cache_items[index].data);
+      // Write out old block, read in new block
+      if (old_occupied && cache_items[index].dirty)
+        block_write (fs_device, old_sector, cache_items[index].data);
 
-          block_read (fs_device, sector, cache_items[index].data);
-          cache_items[index].dirty = false;
+      block_read (fs_device, sector, cache_items[index].data);
+      set_dirty (index, false);
+      cache_items[index].prefetched = prefetch;
 
-          return index;
-        }
+      return index;
     }
-  return index;
 }
 
 void
 block_cache_read_at (block_sector_t sector, void *data, off_t size,
                           off_t offset)
 {
-  size_t index = find_and_access (sector);
+  bool exclusive = false;
+  size_t index = find_and_access (sector, false, &exclusive);
   memcpy (data, cache_items[index].data + offset, size);
-  lock_release (&cache_items[index].access_lock);
+  access_release (index, exclusive);
 }
 
 void
 block_cache_write_at (block_sector_t sector, const void *data, off_t size,
                             off_t offset)
 {
-  size_t index = find_and_access (sector);
+  bool exclusive = true;
+  size_t index = find_and_access (sector, false, &exclusive);
   memcpy (cache_items[index].data + offset, data, size);
-  cache_items[index].dirty = true;
-  lock_release (&cache_items[index].access_lock);
+  set_dirty (index, true);
+  access_release (index, exclusive);
 }
 
 int
-getHitRate () 
+getHitRate (void)
 {
   return hitCnt;
 }
 
+/* Returns a pointer to SECTOR's data in the cache, reading it in if
+   necessary.  The block stays pinned in the cache, and locked, until
+   it is handed back with block_cache_put().  If EXCLUSIVE, the caller
+   may modify the data; otherwise it may only read it, and other
+   readers may share it.  A thread must not get a block it already has
+   pinned. */
+void *
+block_cache_get (block_sector_t sector, bool exclusive)
+{
+  size_t index = find_and_access (sector, false, &exclusive);
+  return cache_items[index].data;
+}
+
+/* Unpins DATA, which must have been returned by block_cache_get().
+   If DIRTY, the block was modified, which requires that it was
+   gotten exclusively. */
+void
+block_cache_put (const void *data, bool dirty)
+{
+  size_t index = ((const uint8_t *) data - cache_data[0]) / BLOCK_SECTOR_SIZE;
+  ASSERT (index < block_cache_size && cache_items[index].data == data);
+
+  bool exclusive = rw_lock_held_for_write (&cache_items[index].access_lock);
+  if (dirty)
+    set_dirty (index, true);
+  access_release (index, exclusive);
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache in the
+   background.  Does not wait for the read. */
+void
+block_cache_prefetch (block_sector_t sector)
+{
+  lock_acquire (&read_ahead_lock);
+  if (read_ahead_cnt < READ_AHEAD_QUEUE_SIZE)
+    {
+      size_t tail = (read_ahead_head + read_ahead_cnt) % READ_AHEAD_QUEUE_SIZE;
+      read_ahead_queue[tail] = sector;
+      read_ahead_cnt++;
+      cond_signal (&read_ahead_cond, &read_ahead_lock);
+    }
+  lock_release (&read_ahead_lock);
+}
+
+/* Services block_cache_prefetch() requests in queue order. */
+static void
+read_ahead_daemon (void *aux UNUSED)
+{
+  while (true)
+    {
+      lock_acquire (&read_ahead_lock);
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_cond, &read_ahead_lock);
+      block_sector_t sector = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_QUEUE_SIZE;
+      read_ahead_cnt--;
+      lock_release (&read_ahead_lock);
+
+      bool exclusive = false;
+      size_t index = find_and_access (sector, true, &exclusive);
+      access_release (index, exclusive);
+    }
+}
+
 int
-getMissRate ()
+getMissRate (void)
 {
   return missCnt;
 }
 
+int
+getProbeCnt (void)
+{
+  return probeCnt;
+}
+
+int
+getPrefetchCnt (void)
+{
+  return prefetchCnt;
+}
+
+int
+getPrefetchHitCnt (void)
+{
+  return prefetchHitCnt;
+}
+
 void
-reset () 
+reset (void)
 {
   hitCnt = 0;
   missCnt = 0;
+  probeCnt = 0;
+  prefetchCnt = 0;
+  prefetchHitCnt = 0;
 }
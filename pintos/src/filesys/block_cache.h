@@ -1,9 +1,15 @@
 #ifndef FILESYS_BLOCK_CACHE_H
 #define FILESYS_BLOCK_CACHE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
+/* Default number of sectors in the buffer cache. */
+#define CACHE_SIZE 64
+extern size_t block_cache_size;
+
 void block_cache_init (void);
 void block_cache_done (void);
 void block_cache_write_out (void);
@@ -11,7 +17,13 @@ void block_cache_write_out (void);
 void block_cache_read_at (block_sector_t, void *, off_t size, off_t offset);
 void block_cache_write_at (block_sector_t, const void *, off_t size,
                             off_t offset);
-int getHitRate ();
-int getMissRate ();
-void reset ();
+void *block_cache_get (block_sector_t, bool exclusive);
+void block_cache_put (const void *, bool dirty);
+void block_cache_prefetch (block_sector_t);
+int getHitRate (void);
+int getMissRate (void);
+int getProbeCnt (void);
+int getPrefetchCnt (void);
+int getPrefetchHitCnt (void);
+void reset (void);
 #endif /* filesys/block_cache.h */
@@ -0,0 +1,182 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Number of cached entries. */
+#define DCACHE_SIZE 128
+
+/* A cached directory entry. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in lru. */
+    bool in_use;                        /* In dentries? */
+    block_sector_t parent;              /* Sector of parent's inode. */
+    char name[NAME_MAX + 1];            /* Null terminated name. */
+    block_sector_t sector;              /* Entry's inode, 0 if none. */
+    bool is_dir;                        /* Entry is a directory? */
+  };
+
+static struct dentry dentry_pool[DCACHE_SIZE];
+static struct hash dentries;    /* Entries in use, by parent and name. */
+static struct list lru;         /* All entries, most recently used first. */
+static struct lock dcache_lock;
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  hash_init (&dentries, dentry_hash, dentry_less, NULL);
+  list_init (&lru);
+  lock_init (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      dentry_pool[i].in_use = false;
+      list_push_back (&lru, &dentry_pool[i].lru_elem);
+    }
+}
+
+/* Returns a hash value for dentry E. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+  if (a->parent != b->parent)
+    return a->parent < b->parent;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the cached entry for NAME in PARENT, or a null pointer
+   if there is none.  Must hold dcache_lock. */
+static struct dentry *
+find_dentry (block_sector_t parent, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Takes D out of the cache and makes it the next entry reused.
+   Must hold dcache_lock. */
+static void
+drop_dentry (struct dentry *d)
+{
+  hash_delete (&dentries, &d->hash_elem);
+  d->in_use = false;
+  list_remove (&d->lru_elem);
+  list_push_back (&lru, &d->lru_elem);
+}
+
+/* Looks up NAME in the directory whose inode is in sector PARENT.
+   On a hit, returns true and sets *SECTORP to the entry's inode
+   sector, or to 0 if NAME is known not to exist, and *IS_DIRP to
+   whether the entry is a directory.  Returns false on a miss. */
+bool
+dcache_lookup (block_sector_t parent, const char *name,
+               block_sector_t *sectorp, bool *is_dirp)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find_dentry (parent, name);
+  if (d != NULL)
+    {
+      *sectorp = d->sector;
+      *is_dirp = d->is_dir;
+      list_remove (&d->lru_elem);
+      list_push_front (&lru, &d->lru_elem);
+    }
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector
+   PARENT refers to the inode in SECTOR, which is a directory if
+   IS_DIR is true, or that NAME does not exist if SECTOR is 0.
+   The caller must hold PARENT's directory lock, so that the entry
+   cannot change between reading it and caching it. */
+void
+dcache_insert (block_sector_t parent, const char *name,
+               block_sector_t sector, bool is_dir)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find_dentry (parent, name);
+  if (d == NULL)
+    {
+      /* Reuse the least recently used entry. */
+      d = list_entry (list_back (&lru), struct dentry, lru_elem);
+      if (d->in_use)
+        hash_delete (&dentries, &d->hash_elem);
+      d->in_use = true;
+      d->parent = parent;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentries, &d->hash_elem);
+    }
+  d->sector = sector;
+  d->is_dir = is_dir;
+  list_remove (&d->lru_elem);
+  list_push_front (&lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Drops any cached entry for NAME in the directory whose inode is
+   in sector PARENT.  Called whenever that entry changes. */
+void
+dcache_invalidate (block_sector_t parent, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find_dentry (parent, name);
+  if (d != NULL)
+    drop_dentry (d);
+  lock_release (&dcache_lock);
+}
+
+/* Drops every cached entry in, or referring to, the inode in
+   SECTOR.  Called when that inode is freed or changes type, so
+   that nothing cached survives the sector's reuse. */
+void
+dcache_forget (block_sector_t sector)
+{
+  size_t i;
+
+  lock_acquire (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      struct dentry *d = &dentry_pool[i];
+      if (d->in_use && (d->parent == sector || d->sector == sector))
+        drop_dentry (d);
+    }
+  lock_release (&dcache_lock);
+}
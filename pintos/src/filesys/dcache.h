@@ -0,0 +1,19 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Cache of directory entries, keyed by the sector of the parent
+   directory's inode and the entry's name.  A cached entry whose
+   sector is 0 records that the name does not exist. */
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t parent, const char *name,
+                    block_sector_t *sectorp, bool *is_dirp);
+void dcache_insert (block_sector_t parent, const char *name,
+                    block_sector_t sector, bool is_dir);
+void dcache_invalidate (block_sector_t parent, const char *name);
+void dcache_forget (block_sector_t sector);
+
+#endif /* filesys/dcache.h */
@@ -1,11 +1,16 @@
 #include "filesys/directory.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
 #include "filesys/block_cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 #define NUM_DIRECT_BLOCKS 123
 
@@ -13,7 +18,7 @@
 struct dir 
   {
     struct inode *inode;                /* Backing store. */
-    off_t pos;                          /* Current position. */
+    off_t pos;                          /* Next entry slot to read. */
   };
 
 /* A single directory entry. */
@@ -24,6 +29,27 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Small directories are a plain array of entries.  Once one no
+   longer fits in a sector, dir_add() rewrites it in the hashed
+   layout: an array of sector-sized buckets, where an entry lives
+   in the bucket its name hashes to or, if that one is full, in the
+   next bucket with a free slot.  A slot that never held an entry
+   is all zeros; a removed entry keeps its name, so that lookups
+   know to probe past a bucket that was once full. */
+#define DIR_BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* One bucket of a hashed directory. */
+struct dir_bucket
+  {
+    struct dir_entry entries[DIR_BUCKET_ENTRIES];
+    uint8_t unused[BLOCK_SECTOR_SIZE
+                   - DIR_BUCKET_ENTRIES * sizeof (struct dir_entry)];
+  };
+
+/* dir_add() doubles a hashed directory rather than probe more
+   than this many buckets for a free slot. */
+#define DIR_MAX_PROBES 4
+
 struct inode_disk
   {
     /* Index structure pointers */
@@ -98,107 +124,205 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns the number of buckets in hashed directory DIR. */
+static size_t
+bucket_cnt (const struct dir *dir)
+{
+  return inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the byte offset of entry slot IDX in DIR. */
+static off_t
+slot_ofs (const struct dir *dir, size_t idx)
+{
+  if (!inode_isHashedDir (dir->inode))
+    return idx * sizeof (struct dir_entry);
+  return (idx / DIR_BUCKET_ENTRIES * BLOCK_SECTOR_SIZE
+          + idx % DIR_BUCKET_ENTRIES * sizeof (struct dir_entry));
+}
+
+/* Reads entry slot IDX of DIR into *EP.
+   Returns false if DIR has no such slot. */
 static bool
-lookup_shallow (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+read_slot (const struct dir *dir, size_t idx, struct dir_entry *ep)
 {
-  struct dir_entry e;
-  size_t ofs;
-  
-  ASSERT (dir != NULL);
-  ASSERT (name != NULL);
+  return (inode_read_at (dir->inode, ep, sizeof *ep, slot_ofs (dir, idx))
+          == sizeof *ep);
+}
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
-  return false;
+/* Reads entry slots IDX onward of DIR into ENTRIES, stopping at
+   the end of DIR, at the end of IDX's bucket if DIR is hashed, or
+   after DIR_BUCKET_ENTRIES slots.
+   Returns the number of slots read. */
+static size_t
+read_slots (const struct dir *dir, size_t idx,
+            struct dir_entry entries[DIR_BUCKET_ENTRIES])
+{
+  size_t cnt = DIR_BUCKET_ENTRIES;
+  if (inode_isHashedDir (dir->inode))
+    cnt -= idx % DIR_BUCKET_ENTRIES;
+  return (inode_read_at (dir->inode, entries, cnt * sizeof *entries,
+                         slot_ofs (dir, idx))
+          / sizeof *entries);
 }
 
+/* Searches hashed directory DIR for NAME, probing from NAME's
+   bucket until it finds NAME or has looked at a bucket that was
+   never full.  Reads one sector per bucket probed.
+   On success, stores the entry in *EP if EP is non-null and its
+   byte offset in *OFSP if OFSP is non-null. */
 static bool
-name_resolution (const struct dir *dir, const char *name, struct dir **retDir, char **retName)
+hashed_lookup (const struct dir *dir, const char *name,
+               struct dir_entry *ep, off_t *ofsp)
 {
-  *retDir = dir_reopen (dir);
-  if (name[0] == '/')
-    {
-      name = name + 1;
-      dir_close (*retDir);
-      *retDir = dir_open_root ();
+  size_t cnt = bucket_cnt (dir);
+  struct dir_bucket *b;
+  bool found = false;
+  bool never_full = false;
+  size_t home, i, k;
 
-      if (name[0] == '\0') {
-        *retName = (char *) malloc(2);
-        strlcpy(*retName, ".", 2);
-        return true;
-      }
+  if (cnt == 0)
+    return false;
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return false;
+
+  home = hash_string (name) % cnt;
+  for (i = 0; i < cnt && !found && !never_full; i++)
+    {
+      off_t bucket_ofs = (home + i) % cnt * BLOCK_SECTOR_SIZE;
+      if (inode_read_at (dir->inode, b, sizeof *b, bucket_ofs) != sizeof *b)
+        break;
+      for (k = 0; k < DIR_BUCKET_ENTRIES && !found; k++)
+        {
+          const struct dir_entry *e = &b->entries[k];
+          if (e->in_use && !strcmp (name, e->name))
+            {
+              found = true;
+              if (ep != NULL)
+                *ep = *e;
+              if (ofsp != NULL)
+                *ofsp = bucket_ofs + k * sizeof *e;
+            }
+          else if (!e->in_use && e->name[0] == '\0')
+            never_full = true;
+        }
     }
 
-  size_t size = strlen (name) + 1;
-  char *namecpy = (char *) malloc (size);
-  strlcpy (namecpy, name, size);
+  free (b);
+  return found;
+}
+
+/* Stores E in the first free slot along the probe sequence of its
+   name in hashed directory DIR, looking at no more than MAX_PROBES
+   buckets.
+   Returns false if none of them has a free slot or if a disk or
+   memory error occurs. */
+static bool
+hashed_add (struct dir *dir, const struct dir_entry *e, size_t max_probes)
+{
+  size_t cnt = bucket_cnt (dir);
+  struct dir_bucket *b;
+  bool success = false;
+  size_t home, i, k;
+
+  if (cnt == 0)
+    return false;
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return false;
 
-  char *saveptr;
-  char *namepart = strtok_r (namecpy, "/", &saveptr);
-  while (namepart != NULL)
+  home = hash_string (e->name) % cnt;
+  for (i = 0; i < cnt && i < max_probes; i++)
     {
-      char *nextpart = strtok_r (NULL, "/", &saveptr);
+      off_t bucket_ofs = (home + i) % cnt * BLOCK_SECTOR_SIZE;
+      if (inode_read_at (dir->inode, b, sizeof *b, bucket_ofs) != sizeof *b)
+        break;
+      for (k = 0; k < DIR_BUCKET_ENTRIES; k++)
+        if (!b->entries[k].in_use)
+          {
+            off_t ofs = bucket_ofs + k * sizeof *e;
+            success = inode_write_at (dir->inode, e, sizeof *e, ofs) == sizeof *e;
+            goto done;
+          }
+    }
 
-      if (nextpart == NULL)
-        {
-          size = strlen (namepart) + 1;
-          *retName = (char *) malloc (size);
-          strlcpy (*retName, namepart, size);
-          free (namecpy);
-          return true;
-        }
+ done:
+  free (b);
+  return success;
+}
 
-      struct dir_entry e;
-      struct inode *in = NULL;
-      if (!lookup_shallow (*retDir, namepart, &e, NULL) ||
-          (in = inode_open (e.inode_sector), !inode_isDir (in)))
-        {
-          if (in != NULL) inode_close (in);
-          dir_close (*retDir);
-          free (namecpy);
-          return false;
-        }
+/* Rewrites DIR in the hashed layout with BUCKETS buckets, holding
+   all of its entries.  The new table must be at least as long as
+   DIR is now.
+   Returns false if the entries do not fit or if a disk or memory
+   error occurs. */
+static bool
+dir_rehash (struct dir *dir, size_t buckets)
+{
+  struct dir_bucket *table;
+  struct dir_entry e;
+  off_t size = buckets * sizeof *table;
+  bool success = false;
+  size_t idx, i, k;
+
+  ASSERT (size >= inode_length (dir->inode));
 
-      struct dir *new_dir = dir_open (in);
-      dir_close (*retDir);
-      *retDir = new_dir;
+  table = calloc (buckets, sizeof *table);
+  if (table == NULL)
+    return false;
 
-      namepart = nextpart;
+  for (idx = 0; read_slot (dir, idx, &e); idx++)
+    {
+      if (!e.in_use)
+        continue;
+      size_t home = hash_string (e.name) % buckets;
+      for (i = 0; i < buckets; i++)
+        {
+          struct dir_bucket *b = &table[(home + i) % buckets];
+          for (k = 0; k < DIR_BUCKET_ENTRIES; k++)
+            if (!b->entries[k].in_use)
+              break;
+          if (k < DIR_BUCKET_ENTRIES)
+            {
+              b->entries[k] = e;
+              break;
+            }
+        }
+      if (i == buckets)
+        goto done;
     }
 
-  return false;
+  if (inode_write_at (dir->inode, table, size, 0) != size)
+    goto done;
+  if (!inode_isHashedDir (dir->inode))
+    inode_setHashedDir (dir->inode);
+  success = true;
+
+ done:
+  free (table);
+  return success;
 }
 
-/* Searches DIR for a file with the given NAME.
+/* Searches DIR, and only DIR, for a file with the given NAME.
+   Must hold DIR's directory lock.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
    otherwise, returns false and ignores EP and OFSP. */
 static bool
-lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+find_entry (const struct dir *dir, const char *name,
+            struct dir_entry *ep, off_t *ofsp) 
 {
-  char *name1;
-  struct dir *dir1;
-  if (!name_resolution (dir, name, &dir1, &name1))
-    return false;
-  dir = dir1;
-  name = name1;
   struct dir_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (inode_isHashedDir (dir->inode))
+    return hashed_lookup (dir, name, ep, ofsp);
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -207,12 +331,143 @@ lookup (const struct dir *dir, const char *name,
           *ep = e;
         if (ofsp != NULL)
           *ofsp = ofs;
-        free (name1);
-        dir_close (dir1);
         return true;
       }
-  free (name1);
-  dir_close (dir1);
+  return false;
+}
+
+/* Returns true if entry E of DIR refers to a directory, taking
+   the answer from the dentry cache if possible and caching it
+   otherwise.  Must hold DIR's directory lock. */
+static bool
+entry_is_dir (const struct dir *dir, const struct dir_entry *e)
+{
+  block_sector_t parent = inode_get_inumber (dir->inode);
+  block_sector_t sector;
+  struct inode *inode;
+  bool is_dir = false;
+
+  if (dcache_lookup (parent, e->name, &sector, &is_dir))
+    return is_dir;
+
+  inode = inode_open (e->inode_sector);
+  if (inode != NULL)
+    {
+      is_dir = inode_isDir (inode);
+      dcache_insert (parent, e->name, e->inode_sector, is_dir);
+      inode_close (inode);
+    }
+  return is_dir;
+}
+
+/* Looks up NAME in the directory whose inode is in sector PARENT,
+   consulting the dentry cache first.  On a miss, reads the
+   directory through *DIRP, opening it first if *DIRP is null, and
+   caches what it finds.
+   Returns true and sets *SECTORP to the entry's inode sector and
+   *IS_DIRP to whether it is a directory if NAME exists, otherwise
+   returns false. */
+static bool
+lookup_cached (block_sector_t parent, struct dir **dirp, const char *name,
+               block_sector_t *sectorp, bool *is_dirp)
+{
+  struct lock *dir_lock;
+  struct dir_entry e;
+  bool found;
+
+  if (dcache_lookup (parent, name, sectorp, is_dirp))
+    return *sectorp != 0;
+
+  if (*dirp == NULL)
+    {
+      *dirp = dir_open (inode_open (parent));
+      if (*dirp == NULL)
+        return false;
+    }
+  if (!inode_isDir ((*dirp)->inode))
+    return false;
+
+  /* Hold the directory lock until the result is cached, so that a
+     dir_add() or dir_remove() cannot come in between. */
+  dir_lock = inode_dir_lock ((*dirp)->inode);
+  lock_acquire (dir_lock);
+  found = find_entry (*dirp, name, &e, NULL);
+  if (found)
+    {
+      *sectorp = e.inode_sector;
+      *is_dirp = entry_is_dir (*dirp, &e);
+    }
+  else
+    dcache_insert (parent, name, 0, false);
+  lock_release (dir_lock);
+  return found;
+}
+
+/* Resolves path NAME relative to DIR.  On success, returns true,
+   sets *RETDIR to the directory that holds the last component of
+   NAME and *RETNAME to a copy of that component ("." if NAME is
+   "/").  The caller must close *RETDIR and free *RETNAME.
+   Intermediate directories are found through the dentry cache and
+   are only opened on a cache miss. */
+static bool
+name_resolution (const struct dir *dir, const char *name, struct dir **retDir, char **retName)
+{
+  char part[NAME_MAX + 1];
+  bool absolute = name[0] == '/';
+  struct dir *cur = absolute ? dir_open_root () : dir_reopen (dir);
+  block_sector_t sector;
+
+  if (cur == NULL)
+    return false;
+  sector = inode_get_inumber (cur->inode);
+
+  for (;;)
+    {
+      const char *next;
+      size_t len;
+      block_sector_t child;
+      bool is_dir;
+
+      while (*name == '/')
+        name++;
+      len = strcspn (name, "/");
+      for (next = name + len; *next == '/'; next++)
+        continue;
+
+      if (*next == '\0')
+        {
+          /* Last component. */
+          if (len == 0 && !absolute)
+            break;
+          if (cur == NULL && (cur = dir_open (inode_open (sector))) == NULL)
+            return false;
+          if (len == 0)
+            {
+              name = ".";
+              len = 1;
+            }
+          *retName = malloc (len + 1);
+          if (*retName == NULL)
+            break;
+          strlcpy (*retName, name, len + 1);
+          *retDir = cur;
+          return true;
+        }
+
+      if (len > NAME_MAX)
+        break;
+      memcpy (part, name, len);
+      part[len] = '\0';
+      if (!lookup_cached (sector, &cur, part, &child, &is_dir) || !is_dir)
+        break;
+
+      dir_close (cur);
+      cur = NULL;
+      sector = child;
+      name = next;
+    }
+
+  dir_close (cur);
   return false;
 }
 
@@ -231,13 +486,15 @@ dir_lookup (const struct dir *dir, const char *name,
   dir = dir1;
   name = name1;
 
-  struct dir_entry e;
+  block_sector_t sector;
+  bool is_dir;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  if (lookup_cached (inode_get_inumber (dir1->inode), &dir1, name,
+                     &sector, &is_dir))
+    *inode = inode_open (sector);
   else
     *inode = NULL;
 
@@ -264,19 +521,39 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 
   struct dir_entry e;
   off_t ofs;
+  size_t used = 0;
   bool success = false;
+  struct lock *dir_lock = inode_dir_lock (dir->inode);
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  lock_acquire (dir_lock);
+
   /* Check NAME for validity. */
   if (*name == '\0' || strlen (name) > NAME_MAX)
     goto done;
 
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  if (find_entry (dir, name, NULL, NULL))
     goto done;
 
+  if (inode_isHashedDir (dir->inode))
+    {
+      /* Hashed: fill a nearby free slot, doubling the table if the
+         probe sequence is crowded. */
+      e.in_use = true;
+      strlcpy (e.name, name, sizeof e.name);
+      e.inode_sector = inode_sector;
+      success = hashed_add (dir, &e, DIR_MAX_PROBES);
+      if (!success && dir_rehash (dir, bucket_cnt (dir) * 2))
+        success = hashed_add (dir, &e, DIR_MAX_PROBES);
+      if (!success)
+        success = hashed_add (dir, &e, SIZE_MAX);
+      dcache_invalidate (inode_get_inumber (dir->inode), name);
+      goto done;
+    }
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -285,7 +562,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
+       ofs += sizeof e, used++) 
     if (!e.in_use)
       break;
 
@@ -293,9 +570,18 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+
+  /* A full directory that has outgrown one sector switches to the
+     hashed layout, at about half load, instead of growing. */
+  if (ofs == inode_length (dir->inode) && used >= DIR_BUCKET_ENTRIES
+      && dir_rehash (dir, DIV_ROUND_UP (ofs, BLOCK_SECTOR_SIZE) * 2))
+    success = hashed_add (dir, &e, SIZE_MAX);
+  else
+    success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
 
  done:
+  lock_release (dir_lock);
   free (name1);
   dir_close (dir1);
   return success;
@@ -320,12 +606,20 @@ dir_remove (struct dir *dir, const char *name)
   struct inode *inode = NULL;
   bool success = false;
   off_t ofs;
+  struct lock *dir_lock = inode_dir_lock (dir->inode);
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  lock_acquire (dir_lock);
+
+  /* "." and ".." are never removed; checking whether they are
+     empty would also take directory locks out of order. */
+  if (!strcmp (name, ".") || !strcmp (name, ".."))
+    goto done;
+
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (!find_entry (dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
@@ -352,10 +646,11 @@ dir_remove (struct dir *dir, const char *name)
         }
     }
 
-  /* Erase directory entry. */
+  /* Erase directory entry, keeping its name (see dir_bucket). */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
 
   /* Remove inode. */
   if (!inode_isDir (inode))
@@ -363,6 +658,7 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  lock_release (dir_lock);
   free (name1);
   dir_close (dir);
 
@@ -380,17 +676,66 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  struct lock *dir_lock = inode_dir_lock (dir->inode);
+  bool found = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  lock_acquire (dir_lock);
+  while (!found && read_slot (dir, dir->pos, &e)) 
     {
-      dir->pos += sizeof e;
+      dir->pos++;
       if (e.in_use && strcmp (e.name, ".") && strcmp (e.name, ".."))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
         } 
     }
-  return false;
+  lock_release (dir_lock);
+  return found;
+}
+
+/* Reads up to CNT entries from DIR, continuing where the last
+   dir_readdir() or dir_getdents() call left off, into ENTRIES.
+   Like dir_readdir(), skips "." and "..".  Reads the directory a
+   sector at a time and takes each entry's type from the dentry
+   cache where it can.
+   Returns the number of entries read, which is 0 at the end of
+   DIR. */
+size_t
+dir_getdents (struct dir *dir, struct dirent *entries, size_t cnt)
+{
+  struct lock *dir_lock = inode_dir_lock (dir->inode);
+  struct dir_bucket *b;
+  size_t n = 0;
+
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return 0;
+
+  lock_acquire (dir_lock);
+  while (n < cnt)
+    {
+      size_t slot_cnt = read_slots (dir, dir->pos, b->entries);
+      size_t k;
+
+      if (slot_cnt == 0)
+        break;
+      for (k = 0; k < slot_cnt && n < cnt; k++)
+        {
+          const struct dir_entry *e = &b->entries[k];
+          dir->pos++;
+          if (e->in_use && strcmp (e->name, ".") && strcmp (e->name, ".."))
+            {
+              struct dirent *d = &entries[n++];
+              d->inumber = e->inode_sector;
+              d->is_dir = entry_is_dir (dir, e);
+              strlcpy (d->name, e->name, sizeof d->name);
+            }
+        }
+    }
+  lock_release (dir_lock);
+
+  free (b);
+  return n;
 }
 
 void 
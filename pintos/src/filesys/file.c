@@ -113,6 +113,48 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE into the CNT buffers described by IOV, filling
+   each in turn, starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than requested if end of file is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int cnt) 
+{
+  off_t bytes_read = inode_readv (file->inode, iov, cnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Writes the CNT buffers described by IOV into FILE, one after
+   another, starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than requested if the disk fills up.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int cnt) 
+{
+  off_t bytes_written = inode_writev (file->inode, iov, cnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, into DST at its current position, entirely inside the
+   file system.
+   Returns the number of bytes actually copied,
+   which may be less than SIZE if end of SRC is reached.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size) 
+{
+  off_t bytes_copied = inode_copy (dst->inode, dst->pos,
+                                   src->inode, src->pos, size);
+  dst->pos += bytes_copied;
+  src->pos += bytes_copied;
+  return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "filesys/block_cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
@@ -12,24 +13,28 @@
 /* Partition that contains the file system. */
 struct block *fs_device;
 
-static void do_format (void);
+static void do_format (bool extents);
 
 /* Initializes the file system module.
-   If FORMAT is true, reformats the file system. */
+   If FORMAT is true, reformats the file system, giving it
+   extent-based inodes if EXTENTS is true. */
 void
-filesys_init (bool format) 
+filesys_init (bool format, bool extents) 
 {
   fs_device = block_get_role (BLOCK_FILESYS);
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  dcache_init ();
   free_map_init ();
 
   block_cache_init ();
 
   if (format) 
-    do_format ();
+    do_format (extents);
+  else
+    inode_load_format (FREE_MAP_SECTOR);
 
   free_map_open ();
 }
@@ -39,9 +44,9 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
-  block_cache_done ();
-
   free_map_close ();
+
+  block_cache_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -57,7 +62,8 @@ filesys_create (const char *name, off_t initial_size)
   if (dir == NULL)
     dir = thread_current ()->current_dir = dir_open_root ();
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  && free_map_allocate_near (inode_get_inumber (dir_get_inode (dir)),
+                                             1, &inode_sector)
                   && inode_create (inode_sector, initial_size)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
@@ -102,9 +108,10 @@ filesys_remove (const char *name)
 
 /* Formats the file system. */
 static void
-do_format (void)
+do_format (bool extents)
 {
   printf ("Formatting file system...");
+  inode_set_extents (extents);
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
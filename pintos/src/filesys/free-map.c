@@ -1,12 +1,31 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Number of free map bits stored in one sector of the free map
+   file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+/* Number of sectors in a block group.  Allocations with a goal
+   stay inside the goal's group when they can, so that a file's
+   blocks end up near each other and near its inode. */
+#define GROUP_SECTORS 1024
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *dirty_map;     /* Free map file sectors that
+                                        differ from free_map. */
+static size_t group_cnt;             /* Number of block groups. */
+static size_t *group_free;           /* Free sectors in each group. */
+static struct lock free_map_lock;    /* Protects all of the above. */
+
+static void count_groups (void);
 
 /* Initializes the free map. */
 void
@@ -17,36 +36,180 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                           BLOCK_SECTOR_SIZE));
+  if (dirty_map == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  group_free = malloc (group_cnt * sizeof *group_free);
+  if (group_free == NULL)
+    PANIC ("block group creation failed--file system device is too large");
+  count_groups ();
+  lock_init (&free_map_lock);
+}
+
+/* Returns the first sector past the end of group G. */
+static size_t
+group_end (size_t g)
+{
+  size_t end = (g + 1) * GROUP_SECTORS;
+  return end < bitmap_size (free_map) ? end : bitmap_size (free_map);
+}
+
+/* Recomputes every group's free sector count from the free map. */
+static void
+count_groups (void)
+{
+  size_t g;
+
+  for (g = 0; g < group_cnt; g++)
+    group_free[g] = bitmap_count (free_map, g * GROUP_SECTORS,
+                                  group_end (g) - g * GROUP_SECTORS, false);
+}
+
+/* Notes that the free map bits for the CNT sectors starting at
+   SECTOR changed and must be written back. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+  bitmap_set_multiple (dirty_map, first, last - first + 1, true);
+}
+
+/* Records that the CNT sectors starting at SECTOR were allocated,
+   if ALLOCATED is true, or released otherwise. */
+static void
+note_change (block_sector_t sector, size_t cnt, bool allocated)
+{
+  mark_dirty (sector, cnt);
+  while (cnt > 0)
+    {
+      size_t g = sector / GROUP_SECTORS;
+      size_t n = group_end (g) - sector;
+      if (n > cnt)
+        n = cnt;
+      if (allocated)
+        group_free[g] -= n;
+      else
+        group_free[g] += n;
+      sector += n;
+      cnt -= n;
+    }
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available.
+   The change reaches the free map file at the next
+   free_map_flush(). */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  lock_acquire (&free_map_lock);
+  block_sector_t sector = bitmap_scan_and_flip_next (free_map, cnt, false);
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      note_change (sector, cnt, true);
+      *sectorp = sector;
+    }
+  lock_release (&free_map_lock);
+  return sector != BITMAP_ERROR;
+}
+
+/* Like free_map_allocate(), but places the sectors close to GOAL:
+   at or after GOAL within GOAL's block group if possible, then
+   anywhere in that group, then in the following groups that have
+   enough free sectors, wrapping around.  Runs longer than a group,
+   or that no single group can hold, are placed next-fit like
+   free_map_allocate(). */
+bool
+free_map_allocate_near (block_sector_t goal, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  size_t sector = BITMAP_ERROR;
+  size_t first = goal < bitmap_size (free_map) ? goal / GROUP_SECTORS : 0;
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  for (i = 0; i < group_cnt && sector == BITMAP_ERROR; i++)
+    {
+      size_t g = (first + i) % group_cnt;
+      size_t start = g * GROUP_SECTORS;
+      if (group_free[g] < cnt)
+        continue;
+      if (i == 0 && goal > start)
+        sector = bitmap_scan_range (free_map, goal, group_end (g), cnt, false);
+      if (sector == BITMAP_ERROR)
+        sector = bitmap_scan_range (free_map, start, group_end (g), cnt, false);
     }
   if (sector != BITMAP_ERROR)
-    *sectorp = sector;
+    bitmap_set_multiple (free_map, sector, cnt, true);
+  else
+    sector = bitmap_scan_and_flip_next (free_map, cnt, false);
+  if (sector != BITMAP_ERROR)
+    {
+      note_change (sector, cnt, true);
+      *sectorp = sector;
+    }
+  lock_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates up to CNT sectors starting exactly at SECTOR, stopping
+   at the first one already in use.
+   Returns the number of sectors allocated, which is 0 if SECTOR
+   itself is in use. */
+size_t
+free_map_extend (block_sector_t sector, size_t cnt)
+{
+  size_t n = 0;
+
+  lock_acquire (&free_map_lock);
+  while (n < cnt && sector + n < bitmap_size (free_map)
+         && !bitmap_test (free_map, sector + n))
+    n++;
+  if (n > 0)
+    {
+      bitmap_set_multiple (free_map, sector, n, true);
+      note_change (sector, n, true);
+    }
+  lock_release (&free_map_lock);
+  return n;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  note_change (sector, cnt, false);
+  lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map file changed since the last
+   flush, so that a whole operation's allocations cost one write
+   per bitmap sector touched instead of one full rewrite each.
+   Writing the free map file never allocates, since all of its
+   sectors are allocated when it is created. */
+void
+free_map_flush (void)
+{
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    for (i = bitmap_scan (dirty_map, 0, 1, true); i != BITMAP_ERROR;
+         i = bitmap_scan (dirty_map, i + 1, 1, true))
+      if (bitmap_write_part (free_map, free_map_file,
+                             i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE))
+        bitmap_reset (dirty_map, i);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,12 +221,15 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  bitmap_set_all (dirty_map, false);
+  count_groups ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
 }
 
@@ -76,10 +242,17 @@ free_map_create (void)
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  /* Write bitmap to file.  The first write allocates the file's
+     sectors; the second records those allocations.  Until
+     free_map_file is set, flushes triggered by the first do
+     nothing. */
+  struct file *file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
+  if (!bitmap_write (free_map, file))
+    PANIC ("can't write free map");
+  free_map_file = file;
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_map, false);
 }
@@ -1,30 +1,68 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include <uio.h>
 #include "threads/synch.h"
 #include "filesys/block_cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
 
-/* Identifies an inode. */
-#define INODE_MAGIC 0x494e4f44
+/* Identifies an inode, and which layout it uses. */
+#define INODE_MAGIC 0x494e4f44          /* Indexed: one pointer per sector. */
+#define EXTENT_MAGIC 0x494e4f45         /* Extents: contiguous runs. */
 
 #define NUM_DIRECT_BLOCKS 123  /* To help make inode_disk exactly 512 bytes. */
 #define NUM_SECTOR_INDIRECT_BLOCKS 128
+#define NUM_EXTENTS 62         /* Likewise, for the extent layout. */
+
+/* Values of inode_disk's isDir. */
+#define DIR_LINEAR 1           /* Directory of consecutive entries. */
+#define DIR_HASHED 2           /* Directory of hash buckets. */
+
+/* Read-ahead window bounds, in sectors.  The window starts at
+   READ_AHEAD_MIN on the first sequential read, doubles on each
+   further sequential read, and collapses to 0 on a random one. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 16
+
+/* Number of closed inodes kept in memory for reuse. */
+#define CLOSED_INODE_MAX 32
+
+/* LENGTH contiguous sectors starting at START. */
+struct extent
+  {
+    block_sector_t start;
+    block_sector_t length;
+  };
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    /* Index structure pointers */
-    block_sector_t direct_blocks[NUM_DIRECT_BLOCKS];
-    block_sector_t indirect_block;
-    block_sector_t doubly_indirect_block;
-
-    uint8_t isDir;
+    union
+      {
+        /* Index structure pointers, if MAGIC is INODE_MAGIC. */
+        struct
+          {
+            block_sector_t direct_blocks[NUM_DIRECT_BLOCKS];
+            block_sector_t indirect_block;
+            block_sector_t doubly_indirect_block;
+          };
+
+        /* Extents in file order, if MAGIC is EXTENT_MAGIC. */
+        struct
+          {
+            struct extent extents[NUM_EXTENTS];
+            uint32_t extent_cnt;
+          };
+      };
+
+    uint8_t isDir;                      /* 0 if a file, else DIR_*. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
   };
@@ -35,9 +73,13 @@ struct indirect_block_sector
     block_sector_t indirect_blocks[NUM_SECTOR_INDIRECT_BLOCKS];
   };
 
-static bool inode_alloc (struct inode_disk *disk_inode, off_t length);
+static bool inode_grow (struct inode_disk *disk_inode, off_t length);
 static bool inode_dealloc (struct inode *inode);
 
+/* Magic number given to newly created inodes, selecting their
+   layout.  Set when the file system is formatted. */
+static unsigned new_inode_magic = INODE_MAGIC;
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -56,86 +98,167 @@ min (size_t x, size_t y)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in inode table. */
+    struct list_elem lru_elem;          /* Element in closed_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers, 0 if closed. */
+    bool loading;                       /* DATA still being read in? */
+    struct condition loaded;            /* Signalled when LOADING clears. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct lock inode_lock;
+    struct lock dir_lock;               /* Serializes directory updates. */
+    struct inode_disk data;             /* Resident copy of the on-disk inode,
+                                           written through on change. */
+
+    /* Sequential read detection, protected by inode_lock. */
+    off_t ra_next;                      /* Offset a sequential read starts at. */
+    size_t ra_window;                   /* Sectors to keep prefetched. */
+    size_t ra_issued;                   /* Sectors before this are requested. */
   };
 
+/* Returns entry IDX of the indirect block in SECTOR, or 0 if
+   SECTOR is itself a hole. */
+static block_sector_t
+indirect_lookup (block_sector_t sector, off_t idx)
+{
+  if (sector == 0)
+    return 0;
+
+  const struct indirect_block_sector *ibs = block_cache_get (sector, false);
+  block_sector_t to_return = ibs->indirect_blocks[idx];
+  block_cache_put (ibs, false);
+  return to_return;
+}
+
+/* Returns the sector holding sector INDEX of the extent-based
+   file described by DATA, or 0 if it falls in a hole, and stores in
+   *RUN how many sectors from there on are contiguous on disk (or in
+   the hole).
+   Returns -1 if no extent covers INDEX. */
+static block_sector_t
+extent_lookup (const struct inode_disk *data, size_t index, size_t *run)
+{
+  uint32_t i;
+  for (i = 0; i < data->extent_cnt; i++)
+    {
+      const struct extent *e = &data->extents[i];
+      if (index < e->length)
+        {
+          *run = e->length - index;
+          return e->start != 0 ? e->start + index : 0;
+        }
+      index -= e->length;
+    }
+  return -1;
+}
+
 /* Returns the block device sector that contains byte offset POS
-   within INODE.
+   within INODE, and stores in *RUN the number of sectors, starting
+   with that one, that lie contiguously on disk and within the file.
+   Returns 0 if POS falls in a hole, which reads as zeros.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos)
+byte_to_run (const struct inode *inode, off_t pos, size_t *run)
 {
   ASSERT (inode != NULL);
-  struct inode_disk *data = calloc (1, sizeof (struct inode_disk));
-  block_cache_read_at (inode->sector, data, BLOCK_SECTOR_SIZE, 0);
 
-  if (pos < data->length)
-    {
-      off_t index = pos / BLOCK_SECTOR_SIZE;  /* Block index. */
-      off_t lim = NUM_DIRECT_BLOCKS;
-      off_t base;
-      block_sector_t to_return;
+  const struct inode_disk *data = &inode->data;
+  if (pos < 0 || pos >= data->length)
+    return -1;
 
-      /* Check direct blocks first. */
-      if (index < lim)
-        {
-          to_return = data->direct_blocks[index];
-          free (data);
-          return to_return;
-        }
-      base = lim;
+  off_t index = pos / BLOCK_SECTOR_SIZE;  /* Block index. */
+  *run = 1;
 
-      /* Check the indirect block next. */
-      lim += NUM_SECTOR_INDIRECT_BLOCKS;
-      if (index < lim)
-        {
-          block_cache_read_at (data->indirect_block, &to_return,
-                                4, 4*(index - base));
-          free (data);
-          return to_return;
-        }
-      base = lim;
+  /* Extents map the whole file from within the inode. */
+  if (data->magic == EXTENT_MAGIC)
+    {
+      block_sector_t sector = extent_lookup (data, index, run);
+      *run = min (*run, bytes_to_sectors (data->length) - index);
+      return sector;
+    }
 
-      /* Check the doubly indirect block next. */
-      lim += NUM_SECTOR_INDIRECT_BLOCKS * NUM_SECTOR_INDIRECT_BLOCKS;
-      if (index < lim)
-        {
-          /* Create different level indices for accessing the doubly indirect block. */
-          off_t i_1 = (index - base) / NUM_SECTOR_INDIRECT_BLOCKS;
-          off_t i_2 = (index - base) % NUM_SECTOR_INDIRECT_BLOCKS;
+  /* Check direct blocks first. */
+  if (index < NUM_DIRECT_BLOCKS)
+    return data->direct_blocks[index];
+  index -= NUM_DIRECT_BLOCKS;
 
-          block_sector_t ibs;
-          block_cache_read_at (data->doubly_indirect_block, &ibs, 4, 4*i_1);
-          block_cache_read_at (ibs, &to_return, 4, 4*i_2);
+  /* Check the indirect block next. */
+  if (index < NUM_SECTOR_INDIRECT_BLOCKS)
+    return indirect_lookup (data->indirect_block, index);
+  index -= NUM_SECTOR_INDIRECT_BLOCKS;
 
-          free (data);
-          return to_return;
-        }
+  /* Check the doubly indirect block next. */
+  if (index < NUM_SECTOR_INDIRECT_BLOCKS * NUM_SECTOR_INDIRECT_BLOCKS)
+    {
+      /* Create different level indices for accessing the doubly indirect block. */
+      off_t i_1 = index / NUM_SECTOR_INDIRECT_BLOCKS;
+      off_t i_2 = index % NUM_SECTOR_INDIRECT_BLOCKS;
+      return indirect_lookup (indirect_lookup (data->doubly_indirect_block,
+                                               i_1), i_2);
     }
 
-  free(data);
   return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Table of in-memory inodes keyed by sector, so that opening a
+   single inode twice returns the same `struct inode'.  It holds
+   every open inode plus the closed ones in closed_inodes, most
+   recently closed first, which a later open revives without
+   rereading the disk.  open_inodes_lock protects both, along with
+   each inode's open_cnt and loading flag.  The lock is never held
+   across disk I/O: a newly opened inode is entered as loading, and
+   anyone else opening it meanwhile waits on that inode alone. */
+static struct hash open_inodes;
+static struct list closed_inodes;
+static size_t closed_inode_cnt;
 static struct lock open_inodes_lock;
 
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  list_init (&closed_inodes);
   lock_init (&open_inodes_lock);
 }
 
+/* Makes inodes created from now on extent-based if EXTENTS is
+   true, or indexed otherwise. */
+void
+inode_set_extents (bool extents)
+{
+  new_inode_magic = extents ? EXTENT_MAGIC : INODE_MAGIC;
+}
+
+/* Makes inodes created from now on use the same layout as the
+   inode in SECTOR, which must already exist on disk. */
+void
+inode_load_format (block_sector_t sector)
+{
+  unsigned magic;
+  block_cache_read_at (sector, &magic, sizeof magic,
+                       offsetof (struct inode_disk, magic));
+  inode_set_extents (magic == EXTENT_MAGIC);
+}
+
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
    device.
@@ -157,9 +280,9 @@ inode_create (block_sector_t sector, off_t length)
   if (disk_inode != NULL)
     {
       disk_inode->length = length;
-      disk_inode->magic = INODE_MAGIC;
+      disk_inode->magic = new_inode_magic;
       disk_inode->isDir = 0;
-      if (inode_alloc (disk_inode, disk_inode->length)) 
+      if (inode_grow (disk_inode, disk_inode->length)) 
         {
           block_cache_write_at (sector, disk_inode, BLOCK_SECTOR_SIZE, 0);
           success = true; 
@@ -175,22 +298,28 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
   lock_acquire (&open_inodes_lock);
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  /* Check whether this inode is already in memory, waiting for
+     another opener to finish reading it in if need be. */
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      inode = hash_entry (e, struct inode, elem);
+      if (inode->open_cnt++ == 0)
         {
-          inode_reopen (inode);
-          lock_release (&open_inodes_lock);
-          return inode; 
+          list_remove (&inode->lru_elem);
+          closed_inode_cnt--;
         }
+      while (inode->loading)
+        cond_wait (&inode->loaded, &open_inodes_lock);
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
@@ -202,13 +331,26 @@ inode_open (block_sector_t sector)
     }
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
+  hash_insert (&open_inodes, &inode->elem);
   inode->open_cnt = 1;
+  inode->loading = true;
+  cond_init (&inode->loaded);
   inode->deny_write_cnt = 0;
   inode->removed = false;
   lock_init (&inode->inode_lock);
+  lock_init (&inode->dir_lock);
+  inode->ra_next = 0;
+  inode->ra_window = 0;
+  inode->ra_issued = 0;
+  lock_release (&open_inodes_lock);
 
+  /* Read the on-disk inode without holding up other opens. */
+  block_cache_read_at (sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
+
+  lock_acquire (&open_inodes_lock);
+  inode->loading = false;
+  cond_broadcast (&inode->loaded, &open_inodes_lock);
   lock_release (&open_inodes_lock);
   return inode;
 }
@@ -219,9 +361,9 @@ inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
     {
-      lock_acquire (&inode->inode_lock);
+      lock_acquire (&open_inodes_lock);
       inode->open_cnt++;
-      lock_release (&inode->inode_lock);
+      lock_release (&open_inodes_lock);
     }
   return inode;
 }
@@ -233,114 +375,212 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
-/* Handles the allocation of indirect pointers.
-   The level is deterined by D. */
-static bool
-inode_alloc_indirect (block_sector_t *indirect_block, size_t remaining_sectors, int d)
+/* Returns the disk sector holding the byte at offset POS within
+   INODE, 0 if POS falls in a hole, or -1 if INODE has no byte at
+   POS. */
+block_sector_t
+inode_get_sector (const struct inode *inode, off_t pos)
+{
+  size_t run;
+  return byte_to_run (inode, pos, &run);
+}
+
+/* Writes zeros to the CNT sectors starting at SECTOR. */
+static void
+zero_sectors (block_sector_t sector, size_t cnt)
 {
-  /* For zeroing out the allocation. */
   static char zeroes[BLOCK_SECTOR_SIZE];
 
-  if (d == 0)
+  while (cnt-- > 0)
+    block_cache_write_at (sector++, zeroes, BLOCK_SECTOR_SIZE, 0);
+}
+
+/* Allocates a sector as close to GOAL as possible for *SLOT if it
+   is still a hole, zeroing the new sector if ZERO is true.
+   Returns *SLOT, or -1 if the disk is full. */
+static block_sector_t
+fill_slot (block_sector_t *slot, bool zero, block_sector_t goal)
+{
+  if (*slot == 0)
     {
-      if (!*indirect_block)
-        {
-          if (!free_map_allocate (1, indirect_block))
-            return false;
-          block_cache_write_at (*indirect_block, zeroes, BLOCK_SECTOR_SIZE, 0);
-        }
-      return true;
+      if (!free_map_allocate_near (goal, 1, slot))
+        return -1;
+      if (zero)
+        zero_sectors (*slot, 1);
     }
-  else
-    {
-      struct indirect_block_sector ibs;
-      if (!*indirect_block)
-        {
-          free_map_allocate (1, indirect_block);
-          block_cache_write_at (*indirect_block, zeroes, BLOCK_SECTOR_SIZE, 0);
-        }
-      block_cache_read_at (*indirect_block, &ibs, BLOCK_SECTOR_SIZE, 0);
+  return *slot;
+}
 
-      size_t unit = d == 1 ? 1 : NUM_SECTOR_INDIRECT_BLOCKS;
-      size_t lim = DIV_ROUND_UP (remaining_sectors, unit);
+/* Like fill_slot(), for entry IDX of the indirect block in SECTOR. */
+static block_sector_t
+indirect_fill (block_sector_t sector, off_t idx, bool zero,
+               block_sector_t goal)
+{
+  struct indirect_block_sector *ibs = block_cache_get (sector, true);
+  bool was_hole = ibs->indirect_blocks[idx] == 0;
+  block_sector_t to_return = fill_slot (&ibs->indirect_blocks[idx], zero,
+                                        goal);
+  block_cache_put (ibs, was_hole);
+  return to_return;
+}
 
-      size_t i;
-      for (i = 0; i < lim; i++)
-        {
-          size_t amt_left = min (remaining_sectors, unit);
-          if (!inode_alloc_indirect (&ibs.indirect_blocks[i], amt_left, d - 1))
-            return false;
-          remaining_sectors -= amt_left;
-        }
+/* Allocates a sector for sector INDEX of the indexed file described
+   by DATA, which must be a hole, along with any indirect blocks on
+   the way to it, all placed as close to GOAL as possible.  The data
+   sector itself is not zeroed.
+   Returns the new sector, or -1 if the disk is full. */
+static block_sector_t
+indexed_fill (struct inode_disk *data, size_t index, block_sector_t goal)
+{
+  if (index < NUM_DIRECT_BLOCKS)
+    return fill_slot (&data->direct_blocks[index], false, goal);
+  index -= NUM_DIRECT_BLOCKS;
 
-      block_cache_write_at (*indirect_block, &ibs, BLOCK_SECTOR_SIZE, 0);
-      return true;
+  if (index < NUM_SECTOR_INDIRECT_BLOCKS)
+    {
+      if (fill_slot (&data->indirect_block, true, goal) == (block_sector_t) -1)
+        return -1;
+      return indirect_fill (data->indirect_block, index, false, goal);
     }
+  index -= NUM_SECTOR_INDIRECT_BLOCKS;
+
+  if (fill_slot (&data->doubly_indirect_block, true, goal)
+      == (block_sector_t) -1)
+    return -1;
+  block_sector_t ib = indirect_fill (data->doubly_indirect_block,
+                                     index / NUM_SECTOR_INDIRECT_BLOCKS, true,
+                                     goal);
+  if (ib == (block_sector_t) -1)
+    return -1;
+  return indirect_fill (ib, index % NUM_SECTOR_INDIRECT_BLOCKS, false, goal);
 }
 
-/* Allocate to DISK_INODE so that it can hold at least LENGTH bytes. */
-static bool
-inode_alloc (struct inode_disk *disk_inode, off_t length)
+/* Allocates sectors for up to CNT sectors of the extent-based file
+   described by DATA, starting at sector INDEX, which must lie in a
+   hole.  The write is kept contiguous with the preceding extent when
+   the sectors after it are free; otherwise the hole is split around
+   a new extent holding the longest run the free map can supply,
+   placed right after the preceding extent if possible or else as
+   close to GOAL as possible.  The new sectors are not zeroed.
+   Returns the first new sector and stores the number allocated in
+   *RUN, or returns -1 if the disk or the extent table is full. */
+static block_sector_t
+extent_fill (struct inode_disk *data, size_t index, size_t cnt,
+             block_sector_t goal, size_t *run)
 {
-  size_t remaining_sectors = bytes_to_sectors (length);
-  size_t lim = min (remaining_sectors, NUM_DIRECT_BLOCKS);
-
-  /* Allocate direct blocks first. */
-  size_t i;
-  for (i = 0; i < lim; i++)
+  struct extent *ext = data->extents;
+  uint32_t i;
+  for (i = 0; i < data->extent_cnt && index >= ext[i].length; i++)
+    index -= ext[i].length;
+  ASSERT (i < data->extent_cnt && ext[i].start == 0);
+
+  cnt = min (cnt, ext[i].length - index);
+  block_sector_t start;
+  size_t got;
+
+  /* Grow the preceding extent in place. */
+  if (index == 0 && i > 0 && ext[i - 1].start != 0)
     {
-      if (!disk_inode->direct_blocks[i])
+      start = ext[i - 1].start + ext[i - 1].length;
+      got = free_map_extend (start, cnt);
+      if (got > 0)
         {
-          if (!free_map_allocate (1, &disk_inode->direct_blocks[i]))
-            return false;
-          /* For zeroing out the allocation. */
-          static char zeroes[BLOCK_SECTOR_SIZE];
-          block_cache_write_at (disk_inode->direct_blocks[i], zeroes, BLOCK_SECTOR_SIZE, 0);
+          ext[i - 1].length += got;
+          ext[i].length -= got;
+          if (ext[i].length == 0)
+            {
+              memmove (&ext[i], &ext[i + 1],
+                       (data->extent_cnt - i - 1) * sizeof *ext);
+              data->extent_cnt--;
+            }
+          *run = got;
+          return start;
         }
     }
-  remaining_sectors -= lim;
-  if(!remaining_sectors)
-    return true;
 
-  /* Allocate the indirect block next. */
-  lim = min(remaining_sectors, NUM_SECTOR_INDIRECT_BLOCKS);
-  if (!inode_alloc_indirect (&disk_inode->indirect_block, lim, 1))
-    return false;
-  remaining_sectors -= lim;
-  if (!remaining_sectors)
-    return true;
+  /* Split the hole around a new extent. */
+  if (i > 0)
+    goal = ext[i - 1].start + ext[i - 1].length;
+  for (got = cnt; !free_map_allocate_near (goal, got, &start); got /= 2)
+    if (got == 1)
+      return -1;
+  size_t before = index;
+  size_t after = ext[i].length - index - got;
+  size_t added = (before > 0) + (after > 0);
+  if (data->extent_cnt + added > NUM_EXTENTS)
+    {
+      free_map_release (start, got);
+      return -1;
+    }
+  memmove (&ext[i + 1 + added], &ext[i + 1],
+           (data->extent_cnt - i - 1) * sizeof *ext);
+  data->extent_cnt += added;
+  if (before > 0)
+    ext[i++].length = before;
+  ext[i].start = start;
+  ext[i].length = got;
+  if (after > 0)
+    {
+      ext[i + 1].start = 0;
+      ext[i + 1].length = after;
+    }
+  *run = got;
+  return start;
+}
+
+/* Grows DISK_INODE's mapping to cover LENGTH bytes.  The new range
+   is a hole: no sectors are allocated until data is written there.
+   Returns false if LENGTH is beyond the largest file the inode's
+   layout can describe. */
+static bool
+inode_grow (struct inode_disk *disk_inode, off_t length)
+{
+  size_t wanted = bytes_to_sectors (length);
 
-  /* Allocate the doubly indirect block next. */
-  lim = min(remaining_sectors, NUM_SECTOR_INDIRECT_BLOCKS * NUM_SECTOR_INDIRECT_BLOCKS);
-  if (!inode_alloc_indirect (&disk_inode->doubly_indirect_block, lim, 2))
-    return false;
-  remaining_sectors -= lim;
-  if(!remaining_sectors)
+  if (disk_inode->magic != EXTENT_MAGIC)
+    return wanted <= (NUM_DIRECT_BLOCKS + NUM_SECTOR_INDIRECT_BLOCKS
+                      + NUM_SECTOR_INDIRECT_BLOCKS * NUM_SECTOR_INDIRECT_BLOCKS);
+
+  size_t mapped = 0;
+  uint32_t i;
+  for (i = 0; i < disk_inode->extent_cnt; i++)
+    mapped += disk_inode->extents[i].length;
+  if (wanted <= mapped)
     return true;
 
-  return false;
+  struct extent *last = NULL;
+  if (disk_inode->extent_cnt > 0)
+    last = &disk_inode->extents[disk_inode->extent_cnt - 1];
+  if (last == NULL || last->start != 0)
+    {
+      if (disk_inode->extent_cnt == NUM_EXTENTS)
+        return false;
+      last = &disk_inode->extents[disk_inode->extent_cnt++];
+      last->start = 0;
+      last->length = 0;
+    }
+  last->length += wanted - mapped;
+  return true;
 }
 
-/* Handles the deallocation of indirect pointers.
-   The level is deterined by D. */
+/* Releases INDIRECT_BLOCK, which sits D levels of indirection
+   above the data, and every sector it maps.  Entries are walked
+   whether or not they lie within the file's length, since a write
+   cut short by a full disk may leave blocks mapped past the end. */
 static void
-inode_dealloc_indirect (block_sector_t indirect_block, size_t remaining_sectors, int d)
+inode_dealloc_indirect (block_sector_t indirect_block, int d)
 {
+  if (indirect_block == 0)
+    return;
   if (d > 0)
     {
-      struct indirect_block_sector ibs;
-      block_cache_read_at (indirect_block, &ibs, BLOCK_SECTOR_SIZE, 0);
-
-      size_t unit = d == 1 ? 1 : NUM_SECTOR_INDIRECT_BLOCKS;
-      size_t lim = DIV_ROUND_UP (remaining_sectors, unit);
+      const struct indirect_block_sector *ibs
+        = block_cache_get (indirect_block, false);
 
       size_t i;
-      for (i = 0; i < lim; i++)
-        {
-          size_t amt_left = min (remaining_sectors, unit);
-          inode_dealloc_indirect (ibs.indirect_blocks[i], amt_left, d - 1);
-          remaining_sectors -= amt_left;
-        }
+      for (i = 0; i < NUM_SECTOR_INDIRECT_BLOCKS; i++)
+        inode_dealloc_indirect (ibs->indirect_blocks[i], d - 1);
+      block_cache_put (ibs, false);
     }
   free_map_release (indirect_block, 1);
 }
@@ -349,65 +589,81 @@ inode_dealloc_indirect (block_sector_t indirect_block, size_t remaining_sectors,
 static bool
 inode_dealloc (struct inode *inode)
 {
-  struct inode_disk *data = calloc (1, sizeof (struct inode_disk));
-  block_cache_read_at (inode->sector, data, BLOCK_SECTOR_SIZE, 0);
+  const struct inode_disk *data = &inode->data;
 
-  size_t remaining_sectors = bytes_to_sectors (data->length);
-  size_t lim = min (remaining_sectors, NUM_DIRECT_BLOCKS);
+  if (data->magic == EXTENT_MAGIC)
+    {
+      uint32_t i;
+      for (i = 0; i < data->extent_cnt; i++)
+        if (data->extents[i].start != 0)
+          free_map_release (data->extents[i].start, data->extents[i].length);
+      return true;
+    }
 
   /* Direct blocks. */
   size_t i;
-  for (i = 0; i < lim; i++)
-    free_map_release (data->direct_blocks[i], 1);
-  remaining_sectors -= lim;
+  for (i = 0; i < NUM_DIRECT_BLOCKS; i++)
+    inode_dealloc_indirect (data->direct_blocks[i], 0);
 
-  /* Indirect block. */
-  lim = min (remaining_sectors, NUM_SECTOR_INDIRECT_BLOCKS);
-  if (lim)
-    {
-      inode_dealloc_indirect (data->indirect_block, lim, 1);
-      remaining_sectors -= lim;
-    }
+  /* Indirect and doubly indirect blocks. */
+  inode_dealloc_indirect (data->indirect_block, 1);
+  inode_dealloc_indirect (data->doubly_indirect_block, 2);
 
-  /* Doubly indirect block. */
-  lim = min (remaining_sectors, NUM_SECTOR_INDIRECT_BLOCKS * NUM_SECTOR_INDIRECT_BLOCKS);
-  if (lim)
-    {
-      inode_dealloc_indirect (data->doubly_indirect_block, lim, 2);
-      remaining_sectors -= lim;
-    }
-
-  free (data);
   return true;
 }
 
-/* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+/* Closes INODE.  Its on-disk copy is always up to date.
+   If this was the last reference to INODE, moves it to the
+   closed_inodes cache, freeing the least recently closed inode if
+   the cache is full.
+   If INODE was also a removed inode, frees its memory and blocks. */
 void
 inode_close (struct inode *inode) 
 {
+  struct inode *victim = NULL;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list and release lock. */
-      lock_acquire (&open_inodes_lock);
-      list_remove (&inode->elem);
       lock_release (&open_inodes_lock);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
+      return;
+    }
+
+  /* Last opener: drop a removed inode, cache any other. */
+  if (inode->removed)
+    {
+      hash_delete (&open_inodes, &inode->elem);
+      victim = inode;
+    }
+  else
+    {
+      list_push_front (&closed_inodes, &inode->lru_elem);
+      if (++closed_inode_cnt > CLOSED_INODE_MAX)
         {
-          free_map_release (inode->sector, 1);
-          inode_dealloc (inode);
+          victim = list_entry (list_pop_back (&closed_inodes),
+                               struct inode, lru_elem);
+          hash_delete (&open_inodes, &victim->elem);
+          closed_inode_cnt--;
         }
+    }
+  lock_release (&open_inodes_lock);
+
+  if (victim == NULL)
+    return;
 
-      free (inode); 
+  /* Deallocate blocks if removed. */
+  if (victim->removed) 
+    {
+      dcache_forget (victim->sector);
+      free_map_release (victim->sector, 1);
+      inode_dealloc (victim);
+      free_map_flush ();
     }
+  free (victim); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -424,33 +680,82 @@ bool
 inode_remove_if_not_open (struct inode *inode)
 {
   ASSERT (inode != NULL);
-  lock_acquire (&inode->inode_lock);
+  lock_acquire (&open_inodes_lock);
   if (inode->open_cnt > 1)
     {
-      lock_release (&inode->inode_lock);
+      lock_release (&open_inodes_lock);
       return false;
     }
   inode->removed = true;
-  lock_release (&inode->inode_lock);
+  lock_release (&open_inodes_lock);
   return true;
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+/* Updates INODE's read-ahead state after a read of LENGTH bytes at
+   OFFSET and asks the buffer cache to prefetch the sectors in the
+   window that follows.  Must hold INODE's inode_lock. */
+static void
+inode_read_ahead (struct inode *inode, off_t offset, off_t length)
+{
+  if (offset == inode->ra_next)
+    inode->ra_window = inode->ra_window == 0
+                       ? READ_AHEAD_MIN
+                       : min (inode->ra_window * 2, READ_AHEAD_MAX);
+  else
+    {
+      inode->ra_window = 0;
+      inode->ra_issued = 0;
+    }
+  inode->ra_next = offset + length;
+  if (inode->ra_window == 0)
+    return;
+
+  size_t first = DIV_ROUND_UP (inode->ra_next, BLOCK_SECTOR_SIZE);
+  size_t last = min (first + inode->ra_window,
+                     bytes_to_sectors (inode_length (inode)));
+  if (first < inode->ra_issued)
+    first = inode->ra_issued;
+
+  size_t i = first;
+  while (i < last)
+    {
+      size_t run;
+      block_sector_t sector = byte_to_run (inode, i * BLOCK_SECTOR_SIZE, &run);
+      if (sector == (block_sector_t) -1)
+        break;
+      if (sector == 0)
+        i += min (run, last - i);
+      else
+        for (; run > 0 && i < last; run--, i++)
+          block_cache_prefetch (sector++);
+    }
+  if (i > inode->ra_issued)
+    inode->ra_issued = i;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, without touching the read-ahead state.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+static off_t
+read_range (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
+  block_sector_t sector_idx = 0;
+  size_t run = 0;
 
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      lock_acquire (&inode->inode_lock);
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
-      lock_release (&inode->inode_lock);
-      if (sector_idx == (block_sector_t) -1) break;
+      /* Disk sector to read, starting byte offset within sector.
+         A contiguous run is mapped once and then walked. */
+      if (run == 0)
+        {
+          lock_acquire (&inode->inode_lock);
+          sector_idx = byte_to_run (inode, offset, &run);
+          lock_release (&inode->inode_lock);
+          if (sector_idx == (block_sector_t) -1) break;
+        }
 
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
@@ -464,55 +769,152 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      /* Read data into caller's buffer */
-      block_cache_read_at (sector_idx, buffer + bytes_read, chunk_size, sector_ofs);
+      /* Read data into caller's buffer; holes read as zeros. */
+      if (sector_idx != 0)
+        block_cache_read_at (sector_idx, buffer + bytes_read, chunk_size, sector_ofs);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
+      if (offset % BLOCK_SECTOR_SIZE == 0)
+        {
+          if (sector_idx != 0)
+            sector_idx++;
+          run--;
+        }
+    }
+
+  return bytes_read;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if an error occurs or end of file is reached. */
+off_t
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  off_t bytes_read = read_range (inode, buffer, size, offset);
+
+  if (bytes_read > 0)
+    {
+      lock_acquire (&inode->inode_lock);
+      inode_read_ahead (inode, offset, bytes_read);
+      lock_release (&inode->inode_lock);
+    }
+
+  return bytes_read;
+}
+
+/* Reads from INODE, starting at position OFFSET, into the CNT
+   buffers described by IOV, filling each in turn.
+   Returns the number of bytes actually read, which may be less
+   than the total size of the buffers if an error occurs or end of
+   file is reached.
+   Like inode_read_at(), does not hold INODE's inode_lock while
+   copying data, so that concurrent readers are not serialized; the
+   read-ahead state is updated once, for the whole range. */
+off_t
+inode_readv (struct inode *inode, const struct iovec *iov, int cnt,
+             off_t offset) 
+{
+  off_t bytes_read = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      off_t chunk = read_range (inode, iov[i].iov_base, iov[i].iov_len,
+                                offset + bytes_read);
+      bytes_read += chunk;
+      if (chunk < (off_t) iov[i].iov_len)
+        break;
+    }
+
+  if (bytes_read > 0)
+    {
+      lock_acquire (&inode->inode_lock);
+      inode_read_ahead (inode, offset, bytes_read);
+      lock_release (&inode->inode_lock);
     }
 
   return bytes_read;
 }
 
+/* Allocates sectors for the hole at byte offset POS in INODE,
+   as many as a write of SIZE bytes there needs, up to the end of
+   the hole.  The sectors go right after the file's preceding data
+   sector if possible, or else near INODE itself.  Must hold
+   INODE's inode_lock.
+   Returns the first new sector and stores the number allocated in
+   *RUN, or returns -1 if the disk is full. */
+static block_sector_t
+inode_fill (struct inode *inode, off_t pos, off_t size, size_t *run)
+{
+  size_t index = pos / BLOCK_SECTOR_SIZE;
+  block_sector_t goal = inode->sector;
+
+  if (inode->data.magic == EXTENT_MAGIC)
+    return extent_fill (&inode->data, index,
+                        bytes_to_sectors (pos % BLOCK_SECTOR_SIZE + size),
+                        goal, run);
+
+  if (index > 0)
+    {
+      block_sector_t prev = byte_to_run (inode, (index - 1) * BLOCK_SECTOR_SIZE,
+                                         run);
+      if (prev != 0 && prev != (block_sector_t) -1)
+        goal = prev + 1;
+    }
+  *run = 1;
+  return indexed_fill (&inode->data, index, goal);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Sets *INODE_CHANGED to true if the in-memory inode_disk was
+   modified and must be written back.  Must hold INODE's
+   inode_lock.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+   less than SIZE if the disk fills up. */
+static off_t
+write_range (struct inode *inode, const void *buffer_, off_t size,
+             off_t offset, bool *inode_changed) 
 {
   const uint8_t *buffer = buffer_;
+  off_t old_length = inode->data.length;
+  off_t start = offset;
   off_t bytes_written = 0;
 
-  if (inode->deny_write_cnt)
-    return 0;
-
-  lock_acquire (&inode->inode_lock);
-
   /* We're beyond the EOF - extend the file. */
-  if (byte_to_sector (inode, offset + size - 1) == -1u)
+  if (size > 0 && offset + size > old_length)
     {
-      struct inode_disk *data = calloc (1, sizeof (struct inode_disk));
-      block_cache_read_at (inode->sector, data, BLOCK_SECTOR_SIZE, 0);
-      if (!inode_alloc (data, offset + size)) 
-        {
-          free (data);
-          return 0;
-        }
-      data->length = offset + size;
-      block_cache_write_at (inode->sector, data, BLOCK_SECTOR_SIZE, 0);
-      free (data);
+      if (!inode_grow (&inode->data, offset + size))
+        return 0;
+      inode->data.length = offset + size;
+      *inode_changed = true;
     }
 
+  block_sector_t sector_idx = 0;
+  size_t run = 0;
+  bool fresh = false;
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
-      ASSERT (sector_idx != (block_sector_t) -1);
+      /* Sector to write, starting byte offset within sector.
+         Sectors in a hole are allocated now. */
+      if (run == 0)
+        {
+          sector_idx = byte_to_run (inode, offset, &run);
+          ASSERT (sector_idx != (block_sector_t) -1);
+          fresh = sector_idx == 0;
+          if (fresh)
+            {
+              sector_idx = inode_fill (inode, offset, size, &run);
+              if (sector_idx == (block_sector_t) -1)
+                break;
+              *inode_changed = true;
+            }
+        }
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -525,19 +927,173 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      /* Write data to disk */
+      /* Write data to disk, zeroing the rest of a new sector. */
+      if (fresh && chunk_size < BLOCK_SECTOR_SIZE)
+        zero_sectors (sector_idx, 1);
       block_cache_write_at (sector_idx, buffer + bytes_written, chunk_size, sector_ofs);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
+      if (offset % BLOCK_SECTOR_SIZE == 0)
+        {
+          sector_idx++;
+          run--;
+        }
     }
 
+  /* A write cut short by a full disk must not leave the file
+     extended over bytes that were never written. */
+  if (inode->data.length > old_length
+      && start + bytes_written < inode->data.length)
+    inode->data.length = (start + bytes_written > old_length
+                          ? start + bytes_written : old_length);
+
+  return bytes_written;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if the disk fills up.
+   A write past end of file extends the file; any gap before
+   OFFSET is left as a hole. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
+                off_t offset) 
+{
+  bool inode_changed = false;
+  off_t bytes_written;
+
+  if (inode->deny_write_cnt)
+    return 0;
+
+  lock_acquire (&inode->inode_lock);
+  bytes_written = write_range (inode, buffer, size, offset, &inode_changed);
+  if (inode_changed)
+    block_cache_write_at (inode->sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
   lock_release (&inode->inode_lock);
+
+  if (inode_changed)
+    free_map_flush ();
   return bytes_written;
 }
 
+/* Writes the CNT buffers described by IOV, one after another, into
+   INODE, starting at OFFSET.  All of them are written under a
+   single acquisition of INODE's inode_lock, so the data lands as
+   one contiguous write and the inode is written back at most once.
+   Returns the number of bytes actually written, which may be less
+   than the total size of the buffers if the disk fills up. */
+off_t
+inode_writev (struct inode *inode, const struct iovec *iov, int cnt,
+              off_t offset) 
+{
+  bool inode_changed = false;
+  off_t bytes_written = 0;
+  int i;
+
+  if (inode->deny_write_cnt)
+    return 0;
+
+  lock_acquire (&inode->inode_lock);
+  for (i = 0; i < cnt; i++)
+    {
+      off_t chunk = write_range (inode, iov[i].iov_base, iov[i].iov_len,
+                                 offset + bytes_written, &inode_changed);
+      bytes_written += chunk;
+      if (chunk < (off_t) iov[i].iov_len)
+        break;
+    }
+  if (inode_changed)
+    block_cache_write_at (inode->sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
+  lock_release (&inode->inode_lock);
+
+  if (inode_changed)
+    free_map_flush ();
+  return bytes_written;
+}
+
+/* Copies SIZE bytes from SRC, starting at SRC_OFS, into DST,
+   starting at DST_OFS, staging at most one block at a time in a
+   kernel buffer instead of passing the data through user memory.
+   Holes in SRC are copied as zeros.
+   No lock on SRC is held while writing DST: SRC's inode_lock is
+   only held to map a block, and its cache block is released once
+   copied out, before DST's inode_lock or cache blocks are taken.
+   Pinning the source block across the write instead would let
+   copies in opposite directions each hold a block the other needs
+   exclusively, and deadlock.
+   Returns the number of bytes copied, which may be less than SIZE
+   if end of SRC is reached or the disk fills up. */
+off_t
+inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  uint8_t *bounce;
+  bool inode_changed = false;
+  off_t bytes_copied = 0;
+
+  if (dst->deny_write_cnt)
+    return 0;
+
+  bounce = malloc (BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    return 0;
+
+  while (size > 0)
+    {
+      int sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      const uint8_t *data = zeros;
+      block_sector_t sector;
+      size_t run;
+      off_t chunk, written;
+
+      /* Map the source block and bound the chunk by it and by the
+         end of SRC. */
+      lock_acquire (&src->inode_lock);
+      sector = byte_to_run (src, src_ofs, &run);
+      chunk = BLOCK_SECTOR_SIZE - sector_ofs;
+      if (chunk > size)
+        chunk = size;
+      if (chunk > inode_length (src) - src_ofs)
+        chunk = inode_length (src) - src_ofs;
+      if (sector != (block_sector_t) -1 && chunk > 0)
+        inode_read_ahead (src, src_ofs, chunk);
+      lock_release (&src->inode_lock);
+      if (sector == (block_sector_t) -1 || chunk <= 0)
+        break;
+
+      if (sector != 0)
+        {
+          block_cache_read_at (sector, bounce, chunk, sector_ofs);
+          data = bounce;
+        }
+
+      lock_acquire (&dst->inode_lock);
+      written = write_range (dst, data, chunk, dst_ofs, &inode_changed);
+      lock_release (&dst->inode_lock);
+
+      bytes_copied += written;
+      src_ofs += written;
+      dst_ofs += written;
+      size -= written;
+      if (written < chunk)
+        break;
+    }
+
+  if (inode_changed)
+    {
+      lock_acquire (&dst->inode_lock);
+      block_cache_write_at (dst->sector, &dst->data, BLOCK_SECTOR_SIZE, 0);
+      lock_release (&dst->inode_lock);
+      free_map_flush ();
+    }
+  free (bounce);
+  return bytes_copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -562,22 +1118,49 @@ inode_allow_write (struct inode *inode)
 off_t
 inode_length (const struct inode *inode)
 {
-  off_t to_return;
-  block_cache_read_at (inode->sector, &to_return, 4, offsetof(struct inode_disk, length));
-  return to_return;
+  return inode->data.length;
 }
 
 bool
 inode_isDir (const struct inode *inode)
 {
-  uint8_t isDir;
-  block_cache_read_at (inode->sector, &isDir, 1, offsetof(struct inode_disk, isDir)); 
-  return isDir;
+  return inode->data.isDir;
+}
+
+/* Sets INODE's isDir byte to KIND and writes it through. */
+static void
+set_dir_kind (struct inode *inode, uint8_t kind)
+{
+  inode->data.isDir = kind;
+  block_cache_write_at (inode->sector, &inode->data.isDir, 1,
+                        offsetof (struct inode_disk, isDir));
 }
 
 void 
-inode_setDir (const struct inode *inode)
+inode_setDir (struct inode *inode)
+{
+  dcache_forget (inode->sector);
+  set_dir_kind (inode, DIR_LINEAR);
+}
+
+/* Returns true if INODE is a directory in the hashed layout. */
+bool
+inode_isHashedDir (const struct inode *inode)
+{
+  return inode->data.isDir == DIR_HASHED;
+}
+
+/* Marks directory INODE as using the hashed layout. */
+void
+inode_setHashedDir (struct inode *inode)
+{
+  set_dir_kind (inode, DIR_HASHED);
+}
+
+/* Returns the lock the directory layer holds while it reads or
+   changes INODE's entries. */
+struct lock *
+inode_dir_lock (struct inode *inode)
 {
-  uint8_t isDir = 1;
-  block_cache_write_at (inode->sector, &isDir, 1, offsetof(struct inode_disk, isDir)); 
+  return &inode->dir_lock;
 }
@@ -6,21 +6,35 @@
 #include "devices/block.h"
 
 struct bitmap;
+struct iovec;
+struct lock;
 
 void inode_init (void);
+void inode_set_extents (bool extents);
+void inode_load_format (block_sector_t);
 bool inode_create (block_sector_t, off_t);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
+block_sector_t inode_get_sector (const struct inode *, off_t pos);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 bool inode_remove_if_not_open (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv (struct inode *, const struct iovec *, int cnt,
+                   off_t offset);
+off_t inode_writev (struct inode *, const struct iovec *, int cnt,
+                    off_t offset);
+off_t inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+                  off_t src_ofs, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 bool inode_isDir (const struct inode *inode);
-void inode_setDir (const struct inode *inode);
+void inode_setDir (struct inode *inode);
+bool inode_isHashedDir (const struct inode *inode);
+void inode_setHashedDir (struct inode *inode);
+struct lock *inode_dir_lock (struct inode *inode);
 
 #endif /* filesys/inode.h */
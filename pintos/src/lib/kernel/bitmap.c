@@ -28,6 +28,7 @@ struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    size_t next_fit;    /* Where bitmap_scan_and_flip_next() starts. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -69,6 +70,15 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask with the CNT bits starting at bit OFS of an
+   element turned on.  OFS + CNT must not exceed ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt)
+{
+  elem_type low = cnt < ELEM_BITS ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1;
+  return low << ofs;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -82,6 +92,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->next_fit = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +115,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->next_fit = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -213,18 +225,31 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, a whole element at a time. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t idx = elem_idx (start);
+      size_t ofs = start % ELEM_BITS;
+      size_t n = cnt < ELEM_BITS - ofs ? cnt : ELEM_BITS - ofs;
+      elem_type mask = range_mask (ofs, n);
+
+      /* See bitmap_mark() and bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+
+      start += n;
+      cnt -= n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -245,21 +270,38 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
   return value_cnt;
 }
 
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+   Elements holding no such bit are skipped whole, and the bit
+   within an element is found with a single bit-scan instruction. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      elem_type e = value ? b->bits[idx] : ~b->bits[idx];
+      e &= (elem_type) -1 << (start % ELEM_BITS);
+      if (e != 0)
+        {
+          size_t bit = idx * ELEM_BITS + __builtin_ctzl (e);
+          return bit < end ? bit : end;
+        }
+      start = (idx + 1) * ELEM_BITS;
+    }
+  return end;
+}
+
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -288,6 +330,48 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the starting index of the first group of CNT
+   consecutive bits in B that are all set to VALUE and start at or
+   after START and at or before LAST, or BITMAP_ERROR if there is
+   none.  LAST + CNT must not exceed B's size. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t last, size_t cnt,
+            bool value)
+{
+  if (cnt == 0)
+    return start <= last ? start : BITMAP_ERROR;
+  while (start <= last)
+    {
+      /* Skip to the next VALUE bit, then measure the group it
+         begins.  A group that is too short is skipped entirely. */
+      start = find_bit (b, start, last + 1, value);
+      if (start > last)
+        break;
+      size_t end = find_bit (b, start, start + cnt, !value);
+      if (end == start + cnt)
+        return start;
+      start = end + 1;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START and ending at or before
+   END that are all set to VALUE.
+   If there is no such group, returns BITMAP_ERROR. */
+size_t
+bitmap_scan_range (const struct bitmap *b, size_t start, size_t end,
+                   size_t cnt, bool value) 
+{
+  ASSERT (b != NULL);
+  ASSERT (start <= end);
+  ASSERT (end <= b->bit_cnt);
+
+  if (cnt <= end - start) 
+    return scan_range (b, start, end - cnt, cnt, value);
+  return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -298,14 +382,8 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
+  if (cnt <= b->bit_cnt && start <= b->bit_cnt - cnt) 
+    return scan_range (b, start, b->bit_cnt - cnt, cnt, value);
   return BITMAP_ERROR;
 }
 
@@ -324,6 +402,35 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip (B, 0, CNT, VALUE), but next-fit:
+   starts looking just past the group the previous call flipped
+   and wraps around to the beginning, so that a bitmap filling up
+   from the front is not rescanned from bit 0 every time.
+   If CNT is zero, returns 0. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t hint, idx;
+
+  ASSERT (b != NULL);
+
+  if (cnt == 0)
+    return 0;
+  if (cnt > b->bit_cnt)
+    return BITMAP_ERROR;
+
+  hint = b->next_fit <= b->bit_cnt - cnt ? b->next_fit : 0;
+  idx = scan_range (b, hint, b->bit_cnt - cnt, cnt, value);
+  if (idx == BITMAP_ERROR && hint > 0)
+    idx = scan_range (b, 0, hint - 1, cnt, value);
+  if (idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->next_fit = idx + cnt;
+    }
+  return idx;
+}
 
 /* File input and output. */
 
@@ -358,6 +465,22 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the SIZE bytes of B's file image that start at byte OFS,
+   clipped to the image's end, to the same offset in FILE.
+   Return true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t ofs, size_t size)
+{
+  size_t image_size = byte_cnt (b->bit_cnt);
+  if (ofs >= image_size)
+    return true;
+  if (size > image_size - ofs)
+    size = image_size - ofs;
+  return (file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+          == (off_t) size);
+}
 #endif /* FILESYS */
 
 /* Debugging. */
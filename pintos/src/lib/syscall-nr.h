@@ -33,7 +33,18 @@ enum
     SYS_HIT,
     SYS_MISS,
     SYS_RESET_CACHE,
-    SYS_WRITE_CNT
+    SYS_WRITE_CNT,
+    SYS_PROBE_CNT,
+    SYS_PREFETCH_CNT,
+    SYS_PREFETCH_HIT,
+    SYS_GETDENTS,               /* Reads many directory entries. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into many buffers. */
+    SYS_WRITEV,                 /* Write many buffers to a file. */
+    SYS_COPY_FILE_RANGE,        /* Copy data between files. */
+    SYS_FORK,                   /* Clone the current process. */
+    SYS_FILE_SECTOR             /* Disk sector holding a file byte. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -61,6 +61,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 int
 practice (int i)
 {
@@ -87,6 +106,12 @@ exec (const char *file)
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
 int
 wait (pid_t pid)
 {
@@ -141,6 +166,36 @@ tell (int fd)
   return syscall1 (SYS_TELL, fd);
 }
 
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int cnt)
+{
+  return syscall3 (SYS_READV, fd, iov, cnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int cnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, cnt);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned length)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, length);
+}
+
 void
 close (int fd)
 {
@@ -177,6 +232,12 @@ readdir (int fd, char name[READDIR_MAX_LEN + 1])
   return syscall2 (SYS_READDIR, fd, name);
 }
 
+int
+getdents (int fd, struct dirent *entries, unsigned cnt) 
+{
+  return syscall3 (SYS_GETDENTS, fd, entries, cnt);
+}
+
 bool
 isdir (int fd) 
 {
@@ -210,3 +271,23 @@ getWriteCnt (int fd)
 {
   return syscall1 (SYS_WRITE_CNT, fd);
 }
+int
+probeCnt (int fd)
+{
+  return syscall1 (SYS_PROBE_CNT, fd);
+}
+int
+prefetchCnt (int fd)
+{
+  return syscall1 (SYS_PREFETCH_CNT, fd);
+}
+int
+prefetchHitCnt (int fd)
+{
+  return syscall1 (SYS_PREFETCH_HIT, fd);
+}
+int
+fileSector (int fd, unsigned offset)
+{
+  return syscall2 (SYS_FILE_SECTOR, fd, offset);
+}
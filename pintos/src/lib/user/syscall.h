@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -23,6 +25,7 @@ typedef int mapid_t;
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t exec (const char *file);
+pid_t fork (void);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -34,6 +37,11 @@ void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
 int practice (int i);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int cnt);
+int writev (int fd, const struct iovec *iov, int cnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
@@ -43,11 +51,16 @@ void munmap (mapid_t);
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
+int getdents (int fd, struct dirent *entries, unsigned cnt);
 bool isdir (int fd);
 int inumber (int fd);
 int hitRate (int fd);
 int missRate (int fd);
 void resetRate (int fd);
 int getWriteCnt (int fd);
+int probeCnt (int fd);
+int prefetchCnt (int fd);
+int prefetchHitCnt (int fd);
+int fileSector (int fd, unsigned offset);
 
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,105 @@
+/* Checks the word-at-a-time bitmap scans and next-fit allocation
+   that the free map and palloc rely on, by building the kernel's
+   lib/kernel/bitmap.c into this program.  Fills a free-map-sized
+   bitmap until only scattered free bits and one free group near
+   the end are left, compares bitmap_scan(), bitmap_count() and
+   bitmap_contains() against bit-by-bit references from many
+   starting points, then allocates every bit next-fit and checks
+   that allocation wraps around to a bit freed behind the hint. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "lib/kernel/bitmap.c"
+
+/* Number of bits in the bitmap: one per sector of an 8 MB disk. */
+#define BIT_CNT 16384
+
+static char bitmap_buf[sizeof (struct bitmap) + BIT_CNT / 8];
+
+/* bitmap.c needs these to link, but bitmap_create_in_buf() below
+   never calls them. */
+void *
+malloc (size_t size UNUSED)
+{
+  return NULL;
+}
+
+void
+free (void *p UNUSED)
+{
+}
+
+/* Reference scan: tests every candidate group bit by bit. */
+static size_t
+slow_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, j;
+
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Reference count: tests CNT bits one by one. */
+static size_t
+slow_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, n = 0;
+
+  for (i = start; i < start + cnt; i++)
+    if (bitmap_test (b, i) == value)
+      n++;
+  return n;
+}
+
+void
+test_main (void)
+{
+  struct bitmap *b;
+  size_t start, cnt, i;
+
+  b = bitmap_create_in_buf (BIT_CNT, bitmap_buf, sizeof bitmap_buf);
+
+  msg ("fill bitmap");
+  bitmap_set_all (b, true);
+  for (i = 0; i < BIT_CNT / 64; i++)
+    bitmap_reset (b, random_ulong () % (BIT_CNT - 64));
+  bitmap_set_multiple (b, BIT_CNT - 16, 8, false);
+
+  msg ("compare scans against bit-by-bit references");
+  for (start = 0; start < BIT_CNT; start += 997)
+    for (cnt = 1; cnt <= 70; cnt += 3)
+      {
+        size_t len = start + cnt <= BIT_CNT ? cnt : BIT_CNT - start;
+        if (bitmap_scan (b, start, cnt, false)
+            != slow_scan (b, start, cnt, false))
+          fail ("bitmap_scan (%zu, %zu) disagrees", start, cnt);
+        if (bitmap_count (b, start, len, false)
+            != slow_count (b, start, len, false))
+          fail ("bitmap_count (%zu, %zu) disagrees", start, len);
+        if (bitmap_contains (b, start, len, false)
+            != (slow_count (b, start, len, false) > 0))
+          fail ("bitmap_contains (%zu, %zu) disagrees", start, len);
+      }
+
+  msg ("allocate every bit next-fit");
+  bitmap_set_all (b, false);
+  for (i = 0; i < BIT_CNT; i++)
+    if (bitmap_scan_and_flip_next (b, 1, false) != i)
+      fail ("allocation %zu came out of order", i);
+  if (bitmap_scan_and_flip_next (b, 1, false) != BITMAP_ERROR)
+    fail ("allocated a bit from a full bitmap");
+
+  msg ("wrap around to a freed bit");
+  bitmap_reset (b, 100);
+  if (bitmap_scan_and_flip_next (b, 1, false) != 100)
+    fail ("next-fit did not wrap around to bit 100");
+}
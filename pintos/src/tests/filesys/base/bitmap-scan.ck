@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bitmap-scan) begin
+(bitmap-scan) fill bitmap
+(bitmap-scan) compare scans against bit-by-bit references
+(bitmap-scan) allocate every bit next-fit
+(bitmap-scan) wrap around to a freed bit
+(bitmap-scan) end
+EOF
+pass;
@@ -0,0 +1,88 @@
+/* Grows two files one sector at a time, in alternation, the way
+   two processes appending to logs at once would, and checks that
+   every data sector of each file was allocated in the block group
+   that holds the file's inode.
+
+   The files are created from a directory made while a filler
+   file had the first block group full, so their inodes, which go
+   near that directory's, are placed in a later group.  The filler is removed before they grow, so an
+   allocator that ignored groups would put their data back in the
+   first one. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Sectors per block group, as in filesys/free-map.c. */
+#define GROUP_SECTORS 1024
+
+/* Number of sectors each file grows by. */
+#define FILE_SECTORS 40
+
+/* Size of the filler file, enough to fill the first group. */
+#define FILLER_SIZE (GROUP_SECTORS * 512)
+
+static char buf[8192];
+
+/* Checks that each of the first FILE_SECTORS sectors of the file
+   open as FD, named NAME, lies in the block group of its inode. */
+static void
+check_group (const char *name, int fd)
+{
+  int group = inumber (fd) / GROUP_SECTORS;
+  int i;
+
+  for (i = 0; i < FILE_SECTORS; i++)
+    {
+      int sector = fileSector (fd, i * 512);
+      if (sector <= 0)
+        fail ("sector %d of \"%s\" is not allocated", i, name);
+      if (sector / GROUP_SECTORS != group)
+        fail ("sector %d of \"%s\" is %d, outside its inode's group %d",
+              i, name, sector, group);
+    }
+}
+
+void
+test_main (void)
+{
+  int fd, fd_a, fd_b;
+  int i;
+
+  CHECK (create ("filler", 0), "create \"filler\"");
+  CHECK ((fd = open ("filler")) > 1, "open \"filler\"");
+  msg ("write \"filler\"");
+  for (i = 0; i < FILLER_SIZE; i += sizeof buf)
+    if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+      fail ("write \"filler\" failed");
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("close \"filler\"");
+  close (fd);
+  CHECK (remove ("filler"), "remove \"filler\"");
+  CHECK (chdir ("d"), "chdir \"d\"");
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((fd_a = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd_b = open ("b")) > 1, "open \"b\"");
+
+  msg ("append %d sectors to \"a\" and \"b\" in turn", FILE_SECTORS);
+  for (i = 0; i < FILE_SECTORS; i++)
+    {
+      memset (buf, 'a', 512);
+      if (write (fd_a, buf, 512) != 512)
+        fail ("write \"a\" failed");
+      memset (buf, 'b', 512);
+      if (write (fd_b, buf, 512) != 512)
+        fail ("write \"b\" failed");
+    }
+
+  if (inumber (fd_a) < GROUP_SECTORS)
+    fail ("\"a\" has inode %d, in the group the filler filled",
+          inumber (fd_a));
+  check_group ("a", fd_a);
+  check_group ("b", fd_b);
+  close (fd_a);
+  close (fd_b);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(block-groups) begin
+(block-groups) create "filler"
+(block-groups) open "filler"
+(block-groups) write "filler"
+(block-groups) mkdir "d"
+(block-groups) close "filler"
+(block-groups) remove "filler"
+(block-groups) chdir "d"
+(block-groups) create "a"
+(block-groups) create "b"
+(block-groups) open "a"
+(block-groups) open "b"
+(block-groups) append 40 sectors to "a" and "b" in turn
+(block-groups) end
+EOF
+pass;
@@ -0,0 +1,4 @@
+/* Runs cache-lookup with the buffer cache raised to 1024 sectors by
+   the -bc kernel flag (see Make.tests). */
+
+#include "tests/filesys/base/cache-lookup.c"
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-lookup-1k) begin
+(cache-lookup-1k) create "ws-8"
+(cache-lookup-1k) open "ws-8"
+(cache-lookup-1k) write "ws-8"
+(cache-lookup-1k) read "ws-8"
+(cache-lookup-1k) create "ws-32"
+(cache-lookup-1k) open "ws-32"
+(cache-lookup-1k) write "ws-32"
+(cache-lookup-1k) read "ws-32"
+(cache-lookup-1k) create "ws-128"
+(cache-lookup-1k) open "ws-128"
+(cache-lookup-1k) write "ws-128"
+(cache-lookup-1k) read "ws-128"
+(cache-lookup-1k) create "ws-512"
+(cache-lookup-1k) open "ws-512"
+(cache-lookup-1k) write "ws-512"
+(cache-lookup-1k) read "ws-512"
+(cache-lookup-1k) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Reads files whose sectors fill a growing share of the buffer
+   cache and checks that the number of index probes per cache
+   lookup stays flat as the number of cached sectors grows.
+   cache-lookup-1k runs the same sweep with a cache 16 times as
+   large, so together they also show that lookup cost does not
+   grow with the size of the cache. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_SECTORS 512
+
+static char buf[MAX_SECTORS * 512];
+
+/* Average probes per lookup, scaled by 100, for a second pass
+   over a file of SECTORS sectors. */
+static int
+probes_per_lookup (int sectors)
+{
+  char file_name[16];
+  size_t size = sectors * 512;
+  int fd;
+  int lookups;
+
+  snprintf (file_name, sizeof file_name, "ws-%d", sectors);
+  CHECK (create (file_name, size), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, size);
+  CHECK (write (fd, buf, size) == (int) size, "write \"%s\"", file_name);
+
+  seek (fd, 0);
+  resetRate (fd);
+  CHECK (read (fd, buf, size) == (int) size, "read \"%s\"", file_name);
+  lookups = hitRate (fd) + missRate (fd);
+  if (lookups <= 0)
+    fail ("no cache lookups while reading \"%s\"", file_name);
+
+  int result = probeCnt (fd) * 100 / lookups;
+  close (fd);
+  return result;
+}
+
+void
+test_main (void)
+{
+  int smallest = probes_per_lookup (8);
+  int largest = smallest;
+  int sectors;
+
+  for (sectors = 32; sectors <= MAX_SECTORS; sectors *= 4)
+    {
+      int cost = probes_per_lookup (sectors);
+      if (cost > largest)
+        largest = cost;
+    }
+
+  /* A linear scan would examine tens of entries per lookup as the
+     working set grows; the index should stay within a few probes. */
+  if (largest > 300 || largest > smallest + 150)
+    fail ("Lookup cost grows with cache occupancy");
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-lookup) begin
+(cache-lookup) create "ws-8"
+(cache-lookup) open "ws-8"
+(cache-lookup) write "ws-8"
+(cache-lookup) read "ws-8"
+(cache-lookup) create "ws-32"
+(cache-lookup) open "ws-32"
+(cache-lookup) write "ws-32"
+(cache-lookup) read "ws-32"
+(cache-lookup) create "ws-128"
+(cache-lookup) open "ws-128"
+(cache-lookup) write "ws-128"
+(cache-lookup) read "ws-128"
+(cache-lookup) create "ws-512"
+(cache-lookup) open "ws-512"
+(cache-lookup) write "ws-512"
+(cache-lookup) read "ws-512"
+(cache-lookup) end
+EOF
+pass;
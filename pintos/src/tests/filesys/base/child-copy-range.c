@@ -0,0 +1,46 @@
+/* Child process for copy-range-par test.
+   Copies one of the test files onto the other PASS_CNT times with
+   copy_file_range(): the first file onto the second if the child's
+   index is even, the second onto the first if it is odd. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/copy-range-par.h"
+
+const char *test_name = "child-copy-range";
+
+int
+main (int argc, const char *argv[])
+{
+  const char *src_name, *dst_name;
+  int child_idx;
+  int in_fd, out_fd;
+  int pass, n, total;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  src_name = file_names[child_idx % 2];
+  dst_name = file_names[1 - child_idx % 2];
+
+  CHECK ((in_fd = open (src_name)) > 1, "open \"%s\"", src_name);
+  CHECK ((out_fd = open (dst_name)) > 1, "open \"%s\"", dst_name);
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      seek (in_fd, 0);
+      seek (out_fd, 0);
+      total = 0;
+      while ((n = copy_file_range (in_fd, out_fd, 1000)) > 0)
+        total += n;
+      if (n < 0 || total != FILE_SIZE)
+        fail ("copied %d bytes from \"%s\", expected %d",
+              total, src_name, FILE_SIZE);
+    }
+  close (in_fd);
+  close (out_fd);
+
+  return child_idx;
+}
@@ -0,0 +1,6 @@
+/* Copies a file repeatedly through a user buffer, as examples/cp.c
+   did before copy_file_range().  Compare its run time with
+   copy-bench's. */
+
+#define COPY_FILE_RANGE 0
+#include "tests/filesys/base/copy-bench.inc"
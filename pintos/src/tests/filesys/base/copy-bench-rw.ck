@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-bench-rw) begin
+(copy-bench-rw) create "src"
+(copy-bench-rw) create "dst"
+(copy-bench-rw) open "src"
+(copy-bench-rw) open "dst"
+(copy-bench-rw) copy "src" to "dst" 50 times
+(copy-bench-rw) end
+EOF
+pass;
@@ -0,0 +1,5 @@
+/* Copies a file repeatedly with copy_file_range().  Compare its
+   run time with copy-bench-rw's. */
+
+#define COPY_FILE_RANGE 1
+#include "tests/filesys/base/copy-bench.inc"
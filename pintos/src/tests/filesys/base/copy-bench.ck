@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-bench) begin
+(copy-bench) create "src"
+(copy-bench) create "dst"
+(copy-bench) open "src"
+(copy-bench) open "dst"
+(copy-bench) copy "src" to "dst" 50 times
+(copy-bench) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Spawns 4 child processes that copy between two files with
+   copy_file_range(), half of them from the first file to the
+   second and half the other way, all over the same blocks at
+   once.  Both files start out identical, so whatever order the
+   copies land in, both must still hold the original data. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/copy-range-par.h"
+
+static char data[FILE_SIZE];
+static char got[FILE_SIZE];
+
+#define CHILD_CNT 4
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int fd;
+  size_t i;
+
+  random_bytes (data, sizeof data);
+  for (i = 0; i < 2; i++)
+    {
+      CHECK (create (file_names[i], 0), "create \"%s\"", file_names[i]);
+      CHECK ((fd = open (file_names[i])) > 1, "open \"%s\"", file_names[i]);
+      if (write (fd, data, sizeof data) != (int) sizeof data)
+        fail ("write \"%s\" failed", file_names[i]);
+      msg ("close \"%s\"", file_names[i]);
+      close (fd);
+    }
+
+  exec_children ("child-copy-range", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (i = 0; i < 2; i++)
+    {
+      CHECK ((fd = open (file_names[i])) > 1, "open \"%s\"", file_names[i]);
+      if (read (fd, got, sizeof got) != (int) sizeof got)
+        fail ("read \"%s\" failed", file_names[i]);
+      compare_bytes (got, data, sizeof data, 0, file_names[i]);
+      msg ("close \"%s\"", file_names[i]);
+      close (fd);
+    }
+}
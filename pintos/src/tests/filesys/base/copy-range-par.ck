@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range-par) begin
+(copy-range-par) create "copy-a"
+(copy-range-par) open "copy-a"
+(copy-range-par) close "copy-a"
+(copy-range-par) create "copy-b"
+(copy-range-par) open "copy-b"
+(copy-range-par) close "copy-b"
+(copy-range-par) exec child 1 of 4: "child-copy-range 0"
+(copy-range-par) exec child 2 of 4: "child-copy-range 1"
+(copy-range-par) exec child 3 of 4: "child-copy-range 2"
+(copy-range-par) exec child 4 of 4: "child-copy-range 3"
+(copy-range-par) wait for child 1 of 4 returned 0 (expected 0)
+(copy-range-par) wait for child 2 of 4 returned 1 (expected 1)
+(copy-range-par) wait for child 3 of 4 returned 2 (expected 2)
+(copy-range-par) wait for child 4 of 4 returned 3 (expected 3)
+(copy-range-par) open "copy-a"
+(copy-range-par) close "copy-a"
+(copy-range-par) open "copy-b"
+(copy-range-par) close "copy-b"
+(copy-range-par) end
+EOF
+pass;
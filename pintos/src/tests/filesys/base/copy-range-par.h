@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_BASE_COPY_RANGE_PAR_H
+#define TESTS_FILESYS_BASE_COPY_RANGE_PAR_H
+
+#define FILE_SIZE 8192
+#define PASS_CNT 4
+static const char *file_names[2] = {"copy-a", "copy-b"};
+
+#endif /* tests/filesys/base/copy-range-par.h */
@@ -0,0 +1,45 @@
+/* Copies a file with copy_file_range() in uneven pieces and checks
+   that the copy matches and that both file positions advanced. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 5000
+
+static char data[FILE_SIZE];
+static char got[FILE_SIZE];
+
+void
+test_main (void)
+{
+  int in_fd, out_fd, n, total;
+
+  random_bytes (data, sizeof data);
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK (create ("dst", 0), "create \"dst\"");
+  CHECK ((in_fd = open ("src")) > 1, "open \"src\"");
+  CHECK ((out_fd = open ("dst")) > 1, "open \"dst\"");
+  if (write (in_fd, data, sizeof data) != (int) sizeof data)
+    fail ("write \"src\" failed");
+  seek (in_fd, 0);
+
+  msg ("copy \"src\" to \"dst\"");
+  total = 0;
+  while ((n = copy_file_range (in_fd, out_fd, 777)) > 0)
+    total += n;
+  if (n < 0 || total != FILE_SIZE)
+    fail ("copied %d bytes, expected %d", total, FILE_SIZE);
+  if (tell (in_fd) != FILE_SIZE || tell (out_fd) != FILE_SIZE)
+    fail ("positions are %u and %u after copy", tell (in_fd), tell (out_fd));
+
+  if (filesize (out_fd) != FILE_SIZE)
+    fail ("\"dst\" is %d bytes long", filesize (out_fd));
+  if (pread (out_fd, got, sizeof got, 0) != (int) sizeof got
+      || memcmp (got, data, sizeof data))
+    fail ("\"dst\" does not match \"src\"");
+  close (in_fd);
+  close (out_fd);
+}
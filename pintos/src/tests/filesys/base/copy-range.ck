@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range) begin
+(copy-range) create "src"
+(copy-range) create "dst"
+(copy-range) open "src"
+(copy-range) open "dst"
+(copy-range) copy "src" to "dst"
+(copy-range) end
+EOF
+pass;
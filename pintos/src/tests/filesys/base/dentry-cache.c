@@ -0,0 +1,51 @@
+/* Resolves a deep path repeatedly while the entries along it are
+   removed and recreated, checking that cached lookups always see
+   the current state of each directory. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *path = "/a/b/c/d/file";
+
+/* Checks that opening PATH succeeds only if EXPECT is true. */
+static void
+check_open (bool expect)
+{
+  int fd = open (path);
+  if ((fd > 1) != expect)
+    fail ("open \"%s\" returned %d", path, fd);
+  if (fd > 1)
+    close (fd);
+}
+
+void
+test_main (void)
+{
+  CHECK (mkdir ("/a"), "mkdir \"/a\"");
+  CHECK (mkdir ("/a/b"), "mkdir \"/a/b\"");
+  CHECK (mkdir ("/a/b/c"), "mkdir \"/a/b/c\"");
+  CHECK (mkdir ("/a/b/c/d"), "mkdir \"/a/b/c/d\"");
+
+  msg ("look up missing file");
+  check_open (false);
+  check_open (false);
+
+  CHECK (create (path, 0), "create \"%s\"", path);
+  check_open (true);
+  check_open (true);
+
+  CHECK (remove (path), "remove \"%s\"", path);
+  check_open (false);
+  CHECK (remove ("/a/b/c/d"), "remove \"/a/b/c/d\"");
+  check_open (false);
+
+  msg ("recreate \"d\" as a file");
+  CHECK (create ("/a/b/c/d", 0), "create \"/a/b/c/d\"");
+  check_open (false);
+  CHECK (remove ("/a/b/c/d"), "remove \"/a/b/c/d\"");
+
+  CHECK (mkdir ("/a/b/c/d"), "mkdir \"/a/b/c/d\"");
+  CHECK (create (path, 0), "create \"%s\"", path);
+  check_open (true);
+}
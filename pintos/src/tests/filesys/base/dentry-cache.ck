@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dentry-cache) begin
+(dentry-cache) mkdir "/a"
+(dentry-cache) mkdir "/a/b"
+(dentry-cache) mkdir "/a/b/c"
+(dentry-cache) mkdir "/a/b/c/d"
+(dentry-cache) look up missing file
+(dentry-cache) create "/a/b/c/d/file"
+(dentry-cache) remove "/a/b/c/d/file"
+(dentry-cache) remove "/a/b/c/d"
+(dentry-cache) recreate "d" as a file
+(dentry-cache) create "/a/b/c/d"
+(dentry-cache) remove "/a/b/c/d"
+(dentry-cache) mkdir "/a/b/c/d"
+(dentry-cache) create "/a/b/c/d/file"
+(dentry-cache) end
+EOF
+pass;
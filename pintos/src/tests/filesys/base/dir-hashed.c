@@ -0,0 +1,56 @@
+/* Fills a directory with enough files that it switches to the
+   hashed layout, removes every other one, and checks that lookups
+   and readdir still see exactly the files that remain. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 200
+
+void
+test_main (void)
+{
+  char name[16];
+  int fd, cnt;
+  int i;
+
+  CHECK (mkdir ("big"), "mkdir \"big\"");
+  CHECK (chdir ("big"), "chdir \"big\"");
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  msg ("remove every other file");
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+
+  msg ("look up every file");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      fd = open (name);
+      if ((fd > 1) != (i % 2 == 1))
+        fail ("open \"%s\" returned %d", name, fd);
+      if (fd > 1)
+        close (fd);
+    }
+
+  CHECK ((fd = open (".")) > 1, "open \".\"");
+  cnt = 0;
+  while (readdir (fd, name))
+    cnt++;
+  close (fd);
+  if (cnt != FILE_CNT / 2)
+    fail ("readdir returned %d entries, expected %d", cnt, FILE_CNT / 2);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-hashed) begin
+(dir-hashed) mkdir "big"
+(dir-hashed) chdir "big"
+(dir-hashed) create 200 files
+(dir-hashed) remove every other file
+(dir-hashed) look up every file
+(dir-hashed) open "."
+(dir-hashed) end
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Grows a file one sector at a time and checks that the number of
+   sectors written to disk stays close to the number of data
+   sectors, so that allocations do not each rewrite the free map. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SECTORS 256
+
+static char buf[512];
+
+void
+test_main (void)
+{
+  const char *file_name = "growing";
+  int fd;
+  int start_cnt, writes;
+  int i;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  start_cnt = getWriteCnt (fd);
+  msg ("append %d sectors to \"%s\"", FILE_SECTORS, file_name);
+  for (i = 0; i < FILE_SECTORS; i++)
+    {
+      random_bytes (buf, sizeof buf);
+      if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+        fail ("write of sector %d failed", i);
+    }
+  writes = getWriteCnt (fd) - start_cnt;
+  close (fd);
+
+  if (writes > FILE_SECTORS + FILE_SECTORS / 2)
+    fail ("Growing by %d sectors wrote %d sectors", FILE_SECTORS, writes);
+}
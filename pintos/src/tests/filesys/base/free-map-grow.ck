@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(free-map-grow) begin
+(free-map-grow) create "growing"
+(free-map-grow) open "growing"
+(free-map-grow) append 256 sectors to "growing"
+(free-map-grow) end
+EOF
+pass;
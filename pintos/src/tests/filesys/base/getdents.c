@@ -0,0 +1,69 @@
+/* Lists a directory with getdents() in small batches and checks
+   that every entry comes back exactly once, with the right type
+   and inode number. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+
+void
+test_main (void)
+{
+  struct dirent entries[3];
+  bool seen[FILE_CNT + 1];
+  char name[16];
+  int dir_fd, fd, cnt, total;
+  int i;
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK (mkdir ("dir/sub"), "mkdir \"dir/sub\"");
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "dir/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  memset (seen, 0, sizeof seen);
+  total = 0;
+  CHECK ((dir_fd = open ("dir")) > 1, "open \"dir\"");
+  while ((cnt = getdents (dir_fd, entries, 3)) > 0)
+    for (i = 0; i < cnt; i++)
+      {
+        const struct dirent *e = &entries[i];
+        int idx;
+
+        if (!strcmp (e->name, "sub"))
+          idx = FILE_CNT;
+        else
+          {
+            idx = atoi (e->name + 1);
+            if (e->name[0] != 'f' || idx < 0 || idx >= FILE_CNT)
+              fail ("unexpected entry \"%s\"", e->name);
+          }
+        if (seen[idx])
+          fail ("entry \"%s\" returned twice", e->name);
+        seen[idx] = true;
+        total++;
+
+        if (e->is_dir != (idx == FILE_CNT))
+          fail ("entry \"%s\" has the wrong type", e->name);
+        snprintf (name, sizeof name, "dir/%s", e->name);
+        if ((fd = open (name)) < 2)
+          fail ("open \"%s\" failed", name);
+        if (inumber (fd) != e->inumber)
+          fail ("entry \"%s\" has inumber %d, expected %d",
+                e->name, e->inumber, inumber (fd));
+        close (fd);
+      }
+  close (dir_fd);
+
+  if (total != FILE_CNT + 1)
+    fail ("getdents returned %d entries, expected %d", total, FILE_CNT + 1);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents) begin
+(getdents) mkdir "dir"
+(getdents) mkdir "dir/sub"
+(getdents) create 40 files
+(getdents) open "dir"
+(getdents) end
+EOF
+pass;
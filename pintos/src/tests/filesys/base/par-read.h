@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+#define BUF_SIZE 8192
+#define CHUNK_SIZE 64
+#define PASS_CNT 4
+static const char file_name[] = "shared";
+
+#endif /* tests/filesys/base/par-read.h */
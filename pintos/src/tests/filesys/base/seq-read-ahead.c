@@ -0,0 +1,48 @@
+/* Reads a file sequentially after pushing it out of the buffer
+   cache and checks that the read-ahead thread prefetched sectors
+   that the reads then hit. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (40 * 512)
+#define FILLER_SIZE (80 * 512)
+
+static char buf[FILLER_SIZE];
+
+void
+test_main (void)
+{
+  const char *file_name = "streamed";
+  const char *filler_name = "filler";
+  int fd, filler_fd;
+  size_t ofs;
+
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, FILE_SIZE);
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"%s\"", file_name);
+
+  /* Write more sectors than the cache holds so that the first
+     file has to come back from disk. */
+  CHECK (create (filler_name, FILLER_SIZE), "create \"%s\"", filler_name);
+  CHECK ((filler_fd = open (filler_name)) > 1, "open \"%s\"", filler_name);
+  CHECK (write (filler_fd, buf, FILLER_SIZE) == FILLER_SIZE,
+         "write \"%s\"", filler_name);
+  close (filler_fd);
+
+  msg ("read \"%s\" sequentially", file_name);
+  seek (fd, 0);
+  resetRate (fd);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += 512)
+    if (read (fd, buf, 512) != 512)
+      fail ("read \"%s\" at offset %zu failed", file_name, ofs);
+
+  if (prefetchCnt (fd) == 0)
+    fail ("No sectors were read ahead");
+  if (prefetchHitCnt (fd) == 0)
+    fail ("No reads hit read-ahead sectors");
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(seq-read-ahead) begin
+(seq-read-ahead) create "streamed"
+(seq-read-ahead) open "streamed"
+(seq-read-ahead) write "streamed"
+(seq-read-ahead) create "filler"
+(seq-read-ahead) open "filler"
+(seq-read-ahead) write "filler"
+(seq-read-ahead) read "streamed" sequentially
+(seq-read-ahead) end
+EOF
+pass;
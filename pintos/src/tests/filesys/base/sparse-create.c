@@ -0,0 +1,45 @@
+/* Creates a 1 MB file, then writes one sector at its far end, and
+   checks that neither step writes the untouched sectors to disk:
+   the space in between must be a hole that reads back as zeros.
+   Eagerly zeroing the file would cost about 2,048 sector writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+
+static char buf[512];
+
+void
+test_main (void)
+{
+  const char *file_name = "sparse";
+  int fd;
+  int start_cnt, writes;
+  size_t i;
+
+  start_cnt = getWriteCnt (0);
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"%s\"", file_name);
+
+  memset (buf, 0x5a, sizeof buf);
+  seek (fd, FILE_SIZE - sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+         "write last sector of \"%s\"", file_name);
+  writes = getWriteCnt (fd) - start_cnt;
+
+  seek (fd, FILE_SIZE / 2);
+  CHECK (read (fd, buf, sizeof buf) == (int) sizeof buf,
+         "read middle of \"%s\"", file_name);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of hole is %d, not 0", i, buf[i]);
+
+  close (fd);
+
+  if (writes > 64)
+    fail ("Creating a sparse file wrote %d sectors", writes);
+}
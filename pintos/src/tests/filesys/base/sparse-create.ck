@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-create) begin
+(sparse-create) create "sparse"
+(sparse-create) open "sparse"
+(sparse-create) filesize "sparse"
+(sparse-create) write last sector of "sparse"
+(sparse-create) read middle of "sparse"
+(sparse-create) end
+EOF
+pass;
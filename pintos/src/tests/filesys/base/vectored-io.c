@@ -0,0 +1,65 @@
+/* Writes a file with writev() and pwrite(), reads it back with
+   readv() and pread(), and checks that the positional calls leave
+   the file position alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char a[100], b[700], c[300];
+static char expect[1100];
+static char got[1100];
+
+void
+test_main (void)
+{
+  const char *file_name = "vectored";
+  struct iovec iov[3];
+  int fd;
+
+  memset (a, 'a', sizeof a);
+  memset (b, 'b', sizeof b);
+  memset (c, 'c', sizeof c);
+  memcpy (expect, a, sizeof a);
+  memcpy (expect + sizeof a, b, sizeof b);
+  memcpy (expect + sizeof a + sizeof b, c, sizeof c);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof a;
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof b;
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof c;
+  CHECK (writev (fd, iov, 3) == (int) sizeof expect, "writev 3 buffers");
+  if (tell (fd) != sizeof expect)
+    fail ("position after writev is %u", tell (fd));
+
+  msg ("pread at offset 50");
+  if (pread (fd, got, 600, 50) != 600)
+    fail ("pread failed");
+  if (memcmp (got, expect + 50, 600))
+    fail ("pread returned wrong data");
+
+  msg ("pwrite at offset 1000");
+  memset (expect + 1000, 'x', 100);
+  if (pwrite (fd, expect + 1000, 100, 1000) != 100)
+    fail ("pwrite failed");
+  if (tell (fd) != sizeof expect)
+    fail ("pwrite moved the position to %u", tell (fd));
+
+  msg ("readv into 2 buffers");
+  seek (fd, 0);
+  iov[0].iov_base = got;
+  iov[0].iov_len = 513;
+  iov[1].iov_base = got + 513;
+  iov[1].iov_len = sizeof got - 513;
+  if (readv (fd, iov, 2) != (int) sizeof got)
+    fail ("readv failed");
+  if (memcmp (got, expect, sizeof got))
+    fail ("readv returned wrong data");
+  close (fd);
+}
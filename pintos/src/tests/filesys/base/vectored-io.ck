@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vectored-io) begin
+(vectored-io) create "vectored"
+(vectored-io) open "vectored"
+(vectored-io) writev 3 buffers
+(vectored-io) pread at offset 50
+(vectored-io) pwrite at offset 1000
+(vectored-io) readv into 2 buffers
+(vectored-io) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Opens a file several times, closes one of the descriptors, and
+   checks that the next open reuses the lowest free descriptor. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int h1, h2, h3, h4;
+
+  CHECK ((h1 = open ("sample.txt")) > 1, "open \"sample.txt\" once");
+  CHECK ((h2 = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+  CHECK ((h3 = open ("sample.txt")) > 1, "open \"sample.txt\" a third time");
+  if (h1 == h2 || h2 == h3 || h1 == h3)
+    fail ("open() returned %d, %d and %d", h1, h2, h3);
+
+  msg ("close second descriptor");
+  close (h2);
+  CHECK ((h4 = open ("sample.txt")) > 1, "open \"sample.txt\" a fourth time");
+  if (h4 != h2)
+    fail ("open() returned %d, expected %d", h4, h2);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-reuse) begin
+(open-reuse) open "sample.txt" once
+(open-reuse) open "sample.txt" again
+(open-reuse) open "sample.txt" a third time
+(open-reuse) close second descriptor
+(open-reuse) open "sample.txt" a fourth time
+(open-reuse) end
+open-reuse: exit(0)
+EOF
+pass;
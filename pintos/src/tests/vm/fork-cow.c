@@ -0,0 +1,43 @@
+/* Forks a child that overwrites memory it shares copy-on-write
+   with its parent, and checks that each process still sees only
+   its own writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096 + 123)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  memset (buf, 'p', sizeof buf);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 'p')
+          exit (1);
+      memset (buf, 'c', sizeof buf);
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 'c')
+          exit (2);
+      exit (81);
+    }
+  if (child == PID_ERROR)
+    fail ("fork() returned %d", child);
+
+  msg ("wait(fork()) = %d", wait (child));
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 'p')
+      fail ("byte %zu changed to '%c' in parent", i, buf[i]);
+  msg ("parent's memory unchanged");
+}
@@ -336,3 +336,120 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as an unheld readers-writer lock. */
+void
+rw_lock_init (struct rw_lock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->can_read);
+  cond_init (&rw->can_write);
+  rw->readers = 0;
+  rw->waiting_writers = 0;
+  rw->writer = NULL;
+}
+
+/* Acquires RW for shared (read) access, sleeping while a writer
+   holds it or is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_lock_acquire_read (struct rw_lock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != thread_current ());
+
+  lock_acquire (&rw->lock);
+  while (rw->writer != NULL || rw->waiting_writers > 0)
+    cond_wait (&rw->can_read, &rw->lock);
+  rw->readers++;
+  lock_release (&rw->lock);
+}
+
+/* Releases shared access to RW.  The last reader out lets a
+   waiting writer in. */
+void
+rw_lock_release_read (struct rw_lock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for exclusive (write) access, sleeping until there
+   are no readers and no other writer.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_lock_acquire_write (struct rw_lock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_lock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->waiting_writers++;
+  while (rw->writer != NULL || rw->readers > 0)
+    cond_wait (&rw->can_write, &rw->lock);
+  rw->waiting_writers--;
+  rw->writer = thread_current ();
+  lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for exclusive access and returns true if
+   successful or false if it is held or busy.
+
+   This function will not sleep. */
+bool
+rw_lock_try_acquire_write (struct rw_lock *rw)
+{
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!rw_lock_held_for_write (rw));
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+  success = rw->writer == NULL && rw->readers == 0;
+  if (success)
+    rw->writer = thread_current ();
+  lock_release (&rw->lock);
+  return success;
+}
+
+/* Releases exclusive access to RW, which must be held by the
+   current thread.  Prefers handing RW to another writer; otherwise
+   wakes every waiting reader. */
+void
+rw_lock_release_write (struct rw_lock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw_lock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->writer = NULL;
+  if (rw->waiting_writers > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  else
+    cond_broadcast (&rw->can_read, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rw_lock_held_for_write (const struct rw_lock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
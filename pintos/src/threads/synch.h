@@ -41,6 +41,27 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.  Any number of readers may hold it at
+   once, or a single writer.  Waiting writers keep new readers out
+   so that writers do not starve. */
+struct rw_lock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition can_read;  /* Signaled when readers may enter. */
+    struct condition can_write; /* Signaled when a writer may enter. */
+    unsigned readers;           /* Number of threads reading. */
+    unsigned waiting_writers;   /* Number of threads waiting to write. */
+    struct thread *writer;      /* Thread writing, or null. */
+  };
+
+void rw_lock_init (struct rw_lock *);
+void rw_lock_acquire_read (struct rw_lock *);
+void rw_lock_release_read (struct rw_lock *);
+void rw_lock_acquire_write (struct rw_lock *);
+bool rw_lock_try_acquire_write (struct rw_lock *);
+void rw_lock_release_write (struct rw_lock *);
+bool rw_lock_held_for_write (const struct rw_lock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
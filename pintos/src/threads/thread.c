@@ -509,10 +509,17 @@ init_thread (struct thread *t, const char *name, int priority)
 
   t->exec_flag = false;
   list_init (&t->children);
-  list_init (&t->all_files);
+  t->fd_table = NULL;
+  t->fd_cnt = 0;
+  t->fd_next = 0;
   t->child_node = NULL;
 
   t->current_dir = NULL;
+#ifdef VM
+  list_init (&t->pinned);
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+#endif
 
   struct thread *parent = running_thread ();
   if (parent->exec_flag)
@@ -2,6 +2,7 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
@@ -108,8 +109,6 @@ struct thread
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
     struct list_elem allelem;           /* List element for all threads list. */
-    // struct file *fd_map[200];
-    // int next_fd;
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
@@ -122,12 +121,25 @@ struct thread
     struct list children;
     struct thread_child_node *child_node;
 
-    struct list all_files;              /* All files currently open. */
+    struct file_info **fd_table;        /* Open files, indexed by fd. */
+    int fd_cnt;                         /* Number of slots in fd_table. */
+    int fd_next;                        /* No free fd is lower than this. */
     struct file *executable;
 
     struct dir *current_dir;
 #endif
 
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct list pinned;                 /* Pages pinned by a syscall. */
+    void *user_esp;                     /* User esp on kernel entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Files mapped by mmap(). */
+    int next_mapid;                     /* Id of the next mapping. */
+#endif
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -154,6 +166,7 @@ tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_close_files (void);
+bool thread_dup_files (struct thread *parent);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
@@ -19,8 +19,15 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static void push_to_stack (void **esp, char **strtok_ptr, char *tok);
 
@@ -78,6 +85,90 @@ process_execute (const char *file_name)
   return tid;
 }
 
+#ifdef VM
+/* What process_fork() hands to start_fork(). */
+struct fork_args
+  {
+    struct thread *parent;              /* Forking process. */
+    struct intr_frame if_;              /* Its user context. */
+  };
+
+/* Starts a new process that is a copy of the current one, whose
+   user context is IF_, with memory shared copy-on-write.  In the
+   child, the system call returns 0.  Returns the new process's
+   thread id, or TID_ERROR if it cannot be created. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct fork_args args;
+  tid_t tid;
+
+  args.parent = thread_current ();
+  args.if_ = *if_;
+
+  /* ARGS lives on our stack, so wait until the child is done with
+     it, as process_execute() waits for load(). */
+  thread_current ()->exec_flag = true;
+  tid = thread_create (thread_name (), PRI_DEFAULT, start_fork, &args);
+  thread_current ()->exec_flag = false;
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  struct thread_child_node *child_node =
+    list_entry (list_back (&thread_current ()->children),
+                struct thread_child_node, elem);
+  sema_down (&child_node->load_sema);
+  if (child_node->load_error)
+    return TID_ERROR;
+  child_node->child_pid = tid;
+
+  return tid;
+}
+
+/* A thread function that copies a forking process and starts the
+   copy running. */
+static void
+start_fork (void *args_)
+{
+  struct fork_args *args = args_;
+  struct thread *parent = args->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = args->if_;
+  bool success = false;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL && !page_table_init (&t->pages))
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+    }
+  if (t->pagedir != NULL)
+    {
+      process_activate ();
+      t->executable = file_reopen (parent->executable);
+      if (t->executable != NULL)
+        {
+          file_deny_write (t->executable);
+          success = page_table_fork (parent) && thread_dup_files (parent);
+        }
+    }
+
+  /* On failure, thread_exit() wakes the parent. */
+  if (!success)
+    thread_exit ();
+  if (t->child_node != NULL)
+    {
+      t->child_node->load_error = false;
+      sema_up (&t->child_node->load_sema);
+    }
+
+  /* Start the copy just as start_process() does. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -108,9 +199,11 @@ start_process (void *file_name_)
   else
     {
       push_to_stack (&if_.esp, &strtok_ptr, tok);
+#ifndef VM
       struct thread *t = thread_current ();
       t->executable = filesys_open (file_name);
       file_deny_write (t->executable);
+#endif
       palloc_free_page (file_name);
     }
 
@@ -237,6 +330,17 @@ process_exit (void)
       file_close (cur->executable);
     }
 
+#ifdef VM
+  /* Write back mapped files and give back the process's frames
+     while its page directory is still in place for the evictor to
+     use. */
+  if (cur->pagedir != NULL)
+    {
+      mmap_unmap_all ();
+      page_table_destroy (&cur->pages);
+    }
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -358,6 +462,14 @@ load (const char *file_name, void (**eip) (void), void **esp)
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+#endif
   process_activate ();
 
   /* Open executable file. */
@@ -367,6 +479,12 @@ load (const char *file_name, void (**eip) (void), void **esp)
       printf ("load: %s: open failed\n", file_name);
       goto done; 
     }
+#ifdef VM
+  /* Segments are read from FILE on demand, so it stays open,
+     and unwritable, until the process exits. */
+  t->executable = file;
+  file_deny_write (file);
+#endif
 
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -451,13 +569,17 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifndef VM
   file_close (file);
+#endif
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -516,6 +638,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, pages are only recorded in the supplemental page
+   table here and are read in by page_fault() on first access.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -526,7 +651,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -535,6 +662,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where to find this page. */
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -554,6 +687,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -564,10 +698,19 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory.  With VM, the page is only reserved here;
+   it, and any pages the stack grows into below it, are allocated
+   when first touched. */
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  if (!page_add_zero (upage, true))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -581,8 +724,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -602,3 +747,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
@@ -1,7 +1,9 @@
 #include "userprog/syscall.h"
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include <uio.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
@@ -19,6 +21,10 @@
 #include "threads/vaddr.h"
 #include <lib/user/syscall.h>
 #include "filesys/block_cache.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
@@ -28,10 +34,14 @@ struct file_info
     bool isDir;
     struct dir *dir_ptr;
     struct file *ptr; /* Pointer to the actual file */
-    int file_id; /* This file's ID */
-    struct list_elem elem; /* For pushing onto the list of files */
   };
 
+/* fds 0 and 1 are the console, so open files start at 2. */
+#define FD_FIRST 2
+
+/* Number of slots in a process's fd table when it first grows. */
+#define FD_TABLE_MIN 16
+
 void
 syscall_init (void)
 {
@@ -42,74 +52,158 @@ syscall_init (void)
 static struct file_info *
 id_to_file (int id)
 {
-  struct list *files = &thread_current ()->all_files;
-  struct list_elem *i;
-  for (i = list_begin (files); i != list_end (files); i = list_next (i))
+  struct thread *t = thread_current ();
+  if (id < FD_FIRST || id >= t->fd_cnt)
+    return NULL;
+  return t->fd_table[id];
+}
+
+/* Gives INFO the lowest free fd of the current process, growing
+   its fd table if there is none.
+   Returns the fd, or -1 if memory is exhausted. */
+static int
+alloc_fd (struct file_info *info)
+{
+  struct thread *t = thread_current ();
+  int fd = t->fd_next > FD_FIRST ? t->fd_next : FD_FIRST;
+
+  while (fd < t->fd_cnt && t->fd_table[fd] != NULL)
+    fd++;
+  if (fd >= t->fd_cnt)
     {
-      struct file_info *curr_info = list_entry (i, struct file_info, elem);
-      if (curr_info->file_id == id)
-        return curr_info;
+      int new_cnt = t->fd_cnt > 0 ? t->fd_cnt * 2 : FD_TABLE_MIN;
+      struct file_info **table = realloc (t->fd_table,
+                                          new_cnt * sizeof *table);
+      if (table == NULL)
+        return -1;
+      memset (table + t->fd_cnt, 0, (new_cnt - t->fd_cnt) * sizeof *table);
+      t->fd_table = table;
+      t->fd_cnt = new_cnt;
     }
-  return NULL;
+
+  t->fd_table[fd] = info;
+  t->fd_next = fd + 1;
+  return fd;
 }
 
-/* Closes all files. Should be called when terminating the thread. */
-void
-thread_close_files (void)
+/* Closes the file or directory open as ID and frees its fd. */
+static void
+close_fd (int id)
 {
-  struct list *files = &thread_current ()->all_files;
-  while (!list_empty (files))
+  struct thread *t = thread_current ();
+  struct file_info *info = t->fd_table[id];
+
+  if (info->isDir)
+    dir_close (info->dir_ptr);
+  else
+    file_close (info->ptr);
+  free (info);
+
+  t->fd_table[id] = NULL;
+  if (id < t->fd_next)
+    t->fd_next = id;
+}
+
+/* Gives the current process a copy of each of PARENT's open files
+   and directories, for fork().  A copied file has its own position,
+   starting from PARENT's.  Returns false if memory is exhausted. */
+bool
+thread_dup_files (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  int fd;
+
+  if (parent->fd_cnt == 0)
+    return true;
+  t->fd_table = calloc (parent->fd_cnt, sizeof *t->fd_table);
+  if (t->fd_table == NULL)
+    return false;
+  t->fd_cnt = parent->fd_cnt;
+  t->fd_next = parent->fd_next;
+
+  for (fd = FD_FIRST; fd < parent->fd_cnt; fd++)
     {
-      struct list_elem *e = list_pop_front (files);
-      struct file_info *f = list_entry (e, struct file_info, elem);
-      if (f->ptr != NULL)
+      struct file_info *src = parent->fd_table[fd];
+      struct file_info *info;
+
+      if (src == NULL)
+        continue;
+      info = malloc (sizeof *info);
+      if (info == NULL)
+        return false;
+      info->isDir = src->isDir;
+      if (src->isDir)
+        info->dir_ptr = dir_reopen (src->dir_ptr);
+      else
         {
-          if (f->isDir)
-            dir_close (f->dir_ptr);
-          else
-            file_close (f->ptr);
-          free (f);
+          info->ptr = file_reopen (src->ptr);
+          if (info->ptr != NULL)
+            file_seek (info->ptr, file_tell (src->ptr));
         }
+      if (src->isDir ? info->dir_ptr == NULL : info->ptr == NULL)
+        {
+          free (info);
+          return false;
+        }
+      t->fd_table[fd] = info;
     }
+  return true;
 }
 
+/* Closes all files. Should be called when terminating the thread. */
+void
+thread_close_files (void)
+{
+  struct thread *t = thread_current ();
+  int fd;
+
+  for (fd = FD_FIRST; fd < t->fd_cnt; fd++)
+    if (t->fd_table[fd] != NULL)
+      close_fd (fd);
+  free (t->fd_table);
+  t->fd_table = NULL;
+  t->fd_cnt = 0;
+}
+
+/* Returns true if ADDR is a mapped user address that the kernel
+   may read, and write too if WRITE. */
 static bool
-check_valid_vaddr (const void *addr)
+check_valid_vaddr (const void *addr, bool write UNUSED)
 {
-  return is_user_vaddr (addr) &&
-          pagedir_get_page (thread_current () -> pagedir, addr);
+  if (!is_user_vaddr (addr))
+    return false;
+#ifdef VM
+  /* Bring the page in and keep it until the call returns, so that
+     it cannot fault while the call holds file system locks. */
+  return page_pin (addr, write);
+#else
+  return pagedir_get_page (thread_current () -> pagedir, addr) != NULL;
+#endif
 }
 
 static bool
 check_valid_cstr (const char *str)
 {
-  if (!check_valid_vaddr (str))
+  if (!check_valid_vaddr (str, false))
     return false;
   const char *p = str;
   while (*p++ != '\0')
-    if ((size_t) p % PGSIZE == 0 && !check_valid_vaddr (p))
+    if ((size_t) p % PGSIZE == 0 && !check_valid_vaddr (p, false))
       return false;
   return true;
 }
 
 static bool
-check_valid_buffer (const void *addr, size_t size)
+check_valid_buffer (const void *addr, size_t size, bool write)
 {
   const void *end = pg_round_down (addr + size - 1);
   const void *p;
   for (p = pg_round_down (addr); p <= end; p += PGSIZE)
-    if (!check_valid_vaddr (p))
+    if (!check_valid_vaddr (p, write))
       return false;
   return true;
 }
 
-static void
-ensure_valid_vaddr (struct intr_frame *f, const void *addr)
-{
-  if (!check_valid_vaddr (addr))
-    thread_kill (f, -1);
-}
-
 static void
 ensure_valid_cstr (struct intr_frame *f, uint32_t str)
 {
@@ -117,303 +211,567 @@ ensure_valid_cstr (struct intr_frame *f, uint32_t str)
     thread_kill (f, -1);
 }
 
+/* Kills the process unless the SIZE bytes at user address BUFADDR
+   are mapped, and writable if the call is going to WRITE them. */
 static void
-ensure_valid_buffer (struct intr_frame *f, uint32_t bufaddr, uint32_t size)
+ensure_valid_buffer (struct intr_frame *f, uint32_t bufaddr, uint32_t size,
+                     bool write)
 {
-  if (!check_valid_buffer ((void *) bufaddr, (size_t) size))
+  if (!check_valid_buffer ((void *) bufaddr, (size_t) size, write))
     thread_kill (f, -1);
 }
 
-static void
-syscall_handler (struct intr_frame *f UNUSED)
+/* Copies the CNT-element iovec array at user address UIOV into
+   IOV, after checking that the array and every buffer it describes
+   lie in mapped user memory, writable if WRITE, so that the
+   transfer itself needs no further checks.  Kills the process if
+   any of them does not.
+   Returns false if CNT is out of range or the buffers add up to
+   more than INT_MAX bytes. */
+static bool
+copy_in_iovec (struct intr_frame *f, uint32_t uiov, uint32_t cnt,
+               struct iovec iov[IOV_MAX], bool write)
 {
-  uint32_t *args = ((uint32_t *) f->esp);
-  ensure_valid_vaddr (f, &args[0]);
+  size_t total = 0;
+  uint32_t i;
 
-  if (thread_current ()->current_dir == NULL)
-    thread_current ()->current_dir = dir_open_root ();
+  if (cnt == 0 || cnt > IOV_MAX)
+    return false;
+  ensure_valid_buffer (f, uiov, cnt * sizeof *iov, false);
+  memcpy (iov, (const void *) uiov, cnt * sizeof *iov);
 
-  if (args[0] == SYS_EXIT)
+  for (i = 0; i < cnt; i++)
     {
-      ensure_valid_vaddr (f, &args[1]);
-      thread_kill (f, args[1]);
+      if (iov[i].iov_len > INT_MAX - total)
+        return false;
+      total += iov[i].iov_len;
+      if (iov[i].iov_len > 0)
+        ensure_valid_buffer (f, (uint32_t) iov[i].iov_base, iov[i].iov_len,
+                             write);
     }
-  else if (args[0] == SYS_PRACTICE)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      f->eax = args[1] + 1;
-    }
-  else if (args[0] == SYS_HALT)
-    {
-      shutdown_power_off ();
-    }
-  else if (args[0] == SYS_EXEC)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_cstr (f, args[1]);
-      tid_t child = process_execute ((const char *) args[1]);
-      f->eax = child == TID_ERROR ? -1 : child;
-    }
-  else if (args[0] == SYS_WAIT)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      f->eax = process_wait (args[1]);
-    }
-  else if (args[0] == SYS_CREATE)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_vaddr (f, &args[2]);
-      ensure_valid_cstr (f, args[1]);
-      f->eax = filesys_create ((char *) args[1], args[2]);
-    }
-  else if (args[0] == SYS_OPEN)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_cstr (f, args[1]);
-
-      struct inode *in;
-      if (!dir_lookup (thread_current ()->current_dir, (const char *) args[1], &in))
-        {
-          f->eax = -1;
-        }
-      else
-        {
-          static int file_id = 2; /* Start at 2 since numbers less than 2 are
-                                     error codes. */
-
-          /* Set up file_info struct to push onto the list of open files. */
-          struct file_info *info = (struct file_info *)
-                                      malloc (sizeof (struct file_info));
-
-          if (!inode_isDir (in)) 
-            {
-              info->ptr = file_open (in);
-              info->file_id = file_id;
-              info->isDir = false;
-            }
-          else
-            {
-              info->dir_ptr = dir_open (in);
-              info->file_id = file_id;
-              info->isDir = true;
-            }
+  return true;
+}
 
-          list_push_back (&thread_current ()->all_files, &info->elem);
+/* System call handlers.  Each gets the interrupt frame, in which it
+   stores its return value, and a copy of its arguments, already
+   checked against the syscall's schema in syscalls[] below. */
 
-          f->eax = file_id++;
-        }
-    }
-  else if (args[0] == SYS_CLOSE)
-    {
-      ensure_valid_vaddr (f, &args[1]);
+static void
+sys_halt (struct intr_frame *f UNUSED, const uint32_t *args UNUSED)
+{
+  shutdown_power_off ();
+}
 
-      struct file_info *main_info = id_to_file (args[1]);
-      if (main_info == NULL)
-        {
-          f->eax = -1;
-        }
-      else
-        {
-          if (main_info->isDir)
-            dir_close (main_info->dir_ptr);
-          else
-            file_close (main_info->ptr);
-          list_remove (&main_info->elem);
-          free (main_info);
-        }
-    }
-  else if (args[0] == SYS_FILESIZE)
-    {
-      ensure_valid_vaddr (f, &args[1]);
+static void
+sys_exit (struct intr_frame *f, const uint32_t *args)
+{
+  thread_kill (f, args[0]);
+}
 
-      struct file_info *info = id_to_file (args[1]);
-      if (info == NULL)
-        {
-          f->eax = -1;
-        }
-      else
-        {
-          f->eax = file_length (info->ptr);
-        }
-    }
-  else if (args[0] == SYS_READ)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_vaddr (f, &args[2]);
-      ensure_valid_vaddr (f, &args[3]);
-      ensure_valid_buffer (f, args[2], args[3]);
+static void
+sys_exec (struct intr_frame *f, const uint32_t *args)
+{
+  tid_t child = process_execute ((const char *) args[0]);
+  f->eax = child == TID_ERROR ? -1 : child;
+}
 
-      /* If fd is 0 then read from the keyboard. */
-      if (args[1] == STDIN_FILENO)
-        {
-          uint32_t i;
-          for (i = 0; i < args[3]; i++)
-            *(uint8_t *) (args[2] + i) = input_getc ();
-        }
-      else if (args[1] == STDOUT_FILENO)
-        {
-          thread_kill (f, -1);
-        }
+#ifdef VM
+static void
+sys_fork (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  /* The child copies our page table while we wait, and must be
+     able to lock every frame in it. */
+  page_unpin_all ();
+  f->eax = process_fork (f);
+}
+#endif
 
-      struct file_info *info = id_to_file (args[1]);
-      if (info == NULL || info->isDir)
-        f->eax = -1;
-      else
-        {
-          f->eax = file_read (info->ptr, (void *) args[2], args[3]);
-        }
-    }
-  else if (args[0] == SYS_WRITE)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_vaddr (f, &args[2]);
-      ensure_valid_vaddr (f, &args[3]);
-      ensure_valid_buffer (f, args[2], args[3]);
+static void
+sys_wait (struct intr_frame *f, const uint32_t *args)
+{
+  f->eax = process_wait (args[0]);
+}
 
-      if (args[1] == STDIN_FILENO)
-        {
-          thread_kill (f, -1);
-        }
-      else if (args[1] == STDOUT_FILENO)
-        {
-          putbuf ((char *) args[2], args[3]);
-        }
+static void
+sys_create (struct intr_frame *f, const uint32_t *args)
+{
+  f->eax = filesys_create ((char *) args[0], args[1]);
+}
 
-      struct file_info *info = id_to_file (args[1]);
-      if (info == NULL || info->isDir)
-        f->eax = -1;
-      else
-        {
-          f->eax = file_write (info->ptr, (void *) args[2], args[3]);
-        }
-    }
+static void
+sys_remove (struct intr_frame *f, const uint32_t *args)
+{
+  f->eax = filesys_remove ((const char *) args[0]);
+}
 
-  else if (args[0] == SYS_REMOVE)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_cstr (f, args[1]);
-      f->eax = filesys_remove ((const char *) args[1]);
-    }
-  else if (args[0] == SYS_SEEK)
+static void
+sys_open (struct intr_frame *f, const uint32_t *args)
+{
+  struct inode *in;
+  if (!dir_lookup (thread_current ()->current_dir, (const char *) args[0], &in))
     {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_vaddr (f, &args[2]);
-      struct file_info *info = id_to_file (args[1]); 
-      if (info != NULL || info->isDir)
-        {
-          file_seek (info->ptr, args[2]);
-        }
-      else
-        f->eax = -1;
+      f->eax = -1;
+      return;
     }
-  else if (args[0] == SYS_TELL)
+
+  /* Set up file_info struct to put in the fd table. */
+  struct file_info *info = (struct file_info *)
+                              malloc (sizeof (struct file_info));
+  int fd = -1;
+
+  if (info == NULL)
+    inode_close (in);
+  else
     {
-      ensure_valid_vaddr (f, &args[1]);
-      struct file_info *info = id_to_file (args[1]); 
-      if (info != NULL) 
+      if (!inode_isDir (in)) 
         {
-          f->eax = file_tell (info->ptr);
+          info->ptr = file_open (in);
+          info->isDir = false;
         }
       else
-        f->eax = -1;
-    }
-  else if (args[0] == SYS_INUMBER)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      struct file_info *main_info = id_to_file (args[1]);
-      if (main_info == NULL)
         {
-          f->eax = -1;
+          info->dir_ptr = dir_open (in);
+          info->isDir = true;
         }
-      else
+
+      fd = alloc_fd (info);
+      if (fd < 0)
         {
-          if (main_info->isDir)
-            f->eax = (int) inode_get_inumber (dir_get_inode (main_info->dir_ptr));
+          if (info->isDir)
+            dir_close (info->dir_ptr);
           else
-            f->eax = (int) inode_get_inumber (file_get_inode (main_info->ptr));
+            file_close (info->ptr);
+          free (info);
         }
     }
-  else if (args[0] == SYS_CHDIR)
+
+  f->eax = fd;
+}
+
+static void
+sys_filesize (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || info->isDir)
+    f->eax = -1;
+  else
+    f->eax = file_length (info->ptr);
+}
+
+static void
+sys_read (struct intr_frame *f, const uint32_t *args)
+{
+  /* If fd is 0 then read from the keyboard. */
+  if (args[0] == STDIN_FILENO)
     {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_cstr (f, args[1]);
-      struct inode *in;
-      if (!dir_lookup (thread_current ()->current_dir, (char *) args[1], &in) || !inode_isDir (in))
-        {
-          f->eax = 0;
-          return;
-        }
-      dir_close (thread_current ()->current_dir);
-      thread_current ()->current_dir = dir_open (in);
-      f->eax = 1;
+      uint32_t i;
+      for (i = 0; i < args[2]; i++)
+        *(uint8_t *) (args[1] + i) = input_getc ();
+      f->eax = args[2];
+      return;
     }
-  else if (args[0] == SYS_MKDIR)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_cstr (f, args[1]);
-      struct inode *in;
-      if (!filesys_create ((const char *) args[1], 0) ||
-          !dir_lookup (thread_current ()->current_dir, (const char *) args[1], &in))
-        {
-          f->eax = 0;
-          return;
-        }
-      f->eax = 1;
-      inode_setDir (in);
+  else if (args[0] == STDOUT_FILENO)
+    thread_kill (f, -1);
+
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || info->isDir)
+    f->eax = -1;
+  else
+    f->eax = file_read (info->ptr, (void *) args[1], args[2]);
+}
 
-      struct dir *dir = dir_open (in);
-      dir_add (dir, ".", inode_get_inumber (in));
-      dir_add_parent (dir, thread_current ()->current_dir, (char *) args[1]);
-      dir_close (dir);
+static void
+sys_write (struct intr_frame *f, const uint32_t *args)
+{
+  if (args[0] == STDIN_FILENO)
+    thread_kill (f, -1);
+  else if (args[0] == STDOUT_FILENO)
+    {
+      putbuf ((char *) args[1], args[2]);
+      f->eax = args[2];
+      return;
     }
-  else if (args[0] == SYS_READDIR)
+
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || info->isDir)
+    f->eax = -1;
+  else
+    f->eax = file_write (info->ptr, (void *) args[1], args[2]);
+}
+
+static void
+sys_pread (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || info->isDir || (off_t) args[3] < 0)
+    f->eax = -1;
+  else
+    f->eax = file_read_at (info->ptr, (void *) args[1], args[2], args[3]);
+}
+
+static void
+sys_pwrite (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || info->isDir || (off_t) args[3] < 0)
+    f->eax = -1;
+  else
+    f->eax = file_write_at (info->ptr, (void *) args[1], args[2], args[3]);
+}
+
+/* Handles readv() and writev(). */
+static void
+sys_readv_writev (struct intr_frame *f, const uint32_t *args, bool write)
+{
+  struct iovec iov[IOV_MAX];
+  struct file_info *info = id_to_file (args[0]);
+
+  if (!copy_in_iovec (f, args[1], args[2], iov, !write))
+    f->eax = -1;
+  else if (write && args[0] == STDOUT_FILENO)
     {
-      ensure_valid_vaddr (f, &args[1]);
-      ensure_valid_vaddr (f, &args[2]);
-      ensure_valid_buffer (f, args[2], READDIR_MAX_LEN);
-      struct file_info *info = id_to_file (args[1]);
-      if (!info->isDir)
-        f->eax = 0;
-      else
+      uint32_t i;
+      f->eax = 0;
+      for (i = 0; i < args[2]; i++)
         {
-          f->eax = dir_readdir (info->dir_ptr, (char *) args[2]);
+          putbuf (iov[i].iov_base, iov[i].iov_len);
+          f->eax += iov[i].iov_len;
         }
     }
-  else if (args[0] == SYS_ISDIR)
-    {
-      ensure_valid_vaddr (f, &args[1]);
-      struct file_info *info = id_to_file (args[1]);
-      if (info == NULL)
-        f->eax = 0;
-      else
-        f->eax = info->isDir;
-    }
-  else if (args[0] == SYS_HIT)
+  else if (info == NULL || info->isDir)
+    f->eax = -1;
+  else if (!write)
+    f->eax = file_readv (info->ptr, iov, args[2]);
+  else
+    f->eax = file_writev (info->ptr, iov, args[2]);
+}
+
+static void
+sys_readv (struct intr_frame *f, const uint32_t *args)
+{
+  sys_readv_writev (f, args, false);
+}
+
+static void
+sys_writev (struct intr_frame *f, const uint32_t *args)
+{
+  sys_readv_writev (f, args, true);
+}
+
+static void
+sys_copy_file_range (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *in = id_to_file (args[0]);
+  struct file_info *out = id_to_file (args[1]);
+  if (in == NULL || in->isDir || out == NULL || out->isDir
+      || args[2] > INT_MAX)
+    f->eax = -1;
+  else
+    f->eax = file_copy (out->ptr, in->ptr, args[2]);
+}
+
+static void
+sys_seek (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]); 
+  if (info != NULL && !info->isDir)
+    file_seek (info->ptr, args[1]);
+  else
+    f->eax = -1;
+}
+
+static void
+sys_tell (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]); 
+  if (info != NULL && !info->isDir)
+    f->eax = file_tell (info->ptr);
+  else
+    f->eax = -1;
+}
+
+static void
+sys_close (struct intr_frame *f, const uint32_t *args)
+{
+  if (id_to_file (args[0]) == NULL)
+    f->eax = -1;
+  else
+    close_fd (args[0]);
+}
+
+#ifdef VM
+static void
+sys_mmap (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  struct file *file;
+
+  if (info == NULL || info->isDir
+      || (file = file_reopen (info->ptr)) == NULL)
+    f->eax = -1;
+  else
+    f->eax = mmap_map (file, (void *) args[1]);
+}
+
+static void
+sys_munmap (struct intr_frame *f UNUSED, const uint32_t *args)
+{
+  mmap_unmap (args[0]);
+}
+#endif
+
+static void
+sys_practice (struct intr_frame *f, const uint32_t *args)
+{
+  f->eax = args[0] + 1;
+}
+
+static void
+sys_inumber (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL)
+    f->eax = -1;
+  else if (info->isDir)
+    f->eax = (int) inode_get_inumber (dir_get_inode (info->dir_ptr));
+  else
+    f->eax = (int) inode_get_inumber (file_get_inode (info->ptr));
+}
+
+static void
+sys_chdir (struct intr_frame *f, const uint32_t *args)
+{
+  struct inode *in;
+  if (!dir_lookup (thread_current ()->current_dir, (char *) args[0], &in))
     {
-        f->eax = getHitRate ();
+      f->eax = 0;
+      return;
     }
-  else if (args[0] == SYS_MISS)
+  if (!inode_isDir (in))
     {
-        f->eax = getMissRate ();
+      inode_close (in);
+      f->eax = 0;
+      return;
     }
+  dir_close (thread_current ()->current_dir);
+  thread_current ()->current_dir = dir_open (in);
+  f->eax = 1;
+}
 
-  else if (args[0] == SYS_RESET_CACHE)
-    {
-        reset ();
-        f->eax = 0;
-    }
-  else if (args[0] == SYS_WRITE_CNT)
+static void
+sys_mkdir (struct intr_frame *f, const uint32_t *args)
+{
+  struct inode *in;
+  if (!filesys_create ((const char *) args[0], 0) ||
+      !dir_lookup (thread_current ()->current_dir, (const char *) args[0], &in))
     {
-        f->eax = writeCnt (fs_device);
+      f->eax = 0;
+      return;
     }
+  f->eax = 1;
+  inode_setDir (in);
+
+  struct dir *dir = dir_open (in);
+  dir_add (dir, ".", inode_get_inumber (in));
+  dir_add_parent (dir, thread_current ()->current_dir, (char *) args[0]);
+  dir_close (dir);
+}
+
+static void
+sys_readdir (struct intr_frame *f, const uint32_t *args)
+{
+  ensure_valid_buffer (f, args[1], READDIR_MAX_LEN + 1, true);
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || !info->isDir)
+    f->eax = 0;
+  else
+    f->eax = dir_readdir (info->dir_ptr, (char *) args[1]);
+}
+
+static void
+sys_getdents (struct intr_frame *f, const uint32_t *args)
+{
+  if (args[2] > (uint32_t) PHYS_BASE / sizeof (struct dirent))
+    thread_kill (f, -1);
+  ensure_valid_buffer (f, args[1], args[2] * sizeof (struct dirent), true);
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || !info->isDir)
+    f->eax = -1;
+  else
+    f->eax = dir_getdents (info->dir_ptr, (struct dirent *) args[1],
+                           args[2]);
+}
+
+static void
+sys_isdir (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  f->eax = info != NULL && info->isDir;
+}
+
+static void
+sys_hit (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  f->eax = getHitRate ();
+}
+
+static void
+sys_miss (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  f->eax = getMissRate ();
+}
+
+static void
+sys_reset_cache (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  reset ();
+  f->eax = 0;
+}
 
-  // SYS_CHDIR,                  /* Change the current directory. */
-  // SYS_MKDIR,                  /* Create a directory. */
-  // SYS_READDIR,                 Reads a directory entry. 
-  // SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-  // SYS_INUMBER                 /* Returns the inode number for a fd. */
+static void
+sys_write_cnt (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  f->eax = writeCnt (fs_device);
+}
+
+static void
+sys_probe_cnt (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  f->eax = getProbeCnt ();
+}
+
+static void
+sys_prefetch_cnt (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  f->eax = getPrefetchCnt ();
+}
+
+static void
+sys_prefetch_hit (struct intr_frame *f, const uint32_t *args UNUSED)
+{
+  f->eax = getPrefetchHitCnt ();
+}
+
+static void
+sys_file_sector (struct intr_frame *f, const uint32_t *args)
+{
+  struct file_info *info = id_to_file (args[0]);
+  if (info == NULL || info->isDir || (off_t) args[1] < 0)
+    f->eax = -1;
   else
+    f->eax = (int) inode_get_sector (file_get_inode (info->ptr), args[1]);
+}
+
+/* How syscall_handler() checks an argument before the handler
+   sees it. */
+enum arg_kind
+  {
+    ARG_INT,                    /* Any value; the handler checks it. */
+    ARG_CSTR,                   /* Null-terminated user string. */
+    ARG_BUFFER,                 /* User buffer the call only reads,
+                                   sized by the next arg. */
+    ARG_WBUFFER                 /* User buffer the call writes into,
+                                   sized by the next arg. */
+  };
+
+/* Most arguments any system call takes. */
+#define SYSCALL_MAX_ARGS 4
+
+/* A system call's handler and argument schema. */
+struct syscall
+  {
+    void (*func) (struct intr_frame *, const uint32_t *args);
+    int arg_cnt;                            /* Number of arguments. */
+    enum arg_kind kinds[SYSCALL_MAX_ARGS];  /* Kind of each argument. */
+  };
+
+/* System calls, indexed by number.  Numbers with no handler, such
+   as those of unimplemented calls, are left zeroed. */
+static const struct syscall syscalls[] =
+  {
+    [SYS_HALT] = {sys_halt, 0, {}},
+    [SYS_EXIT] = {sys_exit, 1, {ARG_INT}},
+    [SYS_EXEC] = {sys_exec, 1, {ARG_CSTR}},
+    [SYS_WAIT] = {sys_wait, 1, {ARG_INT}},
+    [SYS_CREATE] = {sys_create, 2, {ARG_CSTR, ARG_INT}},
+    [SYS_REMOVE] = {sys_remove, 1, {ARG_CSTR}},
+    [SYS_OPEN] = {sys_open, 1, {ARG_CSTR}},
+    [SYS_FILESIZE] = {sys_filesize, 1, {ARG_INT}},
+    [SYS_READ] = {sys_read, 3, {ARG_INT, ARG_WBUFFER, ARG_INT}},
+    [SYS_WRITE] = {sys_write, 3, {ARG_INT, ARG_BUFFER, ARG_INT}},
+    [SYS_SEEK] = {sys_seek, 2, {ARG_INT, ARG_INT}},
+    [SYS_TELL] = {sys_tell, 1, {ARG_INT}},
+    [SYS_CLOSE] = {sys_close, 1, {ARG_INT}},
+#ifdef VM
+    [SYS_MMAP] = {sys_mmap, 2, {ARG_INT, ARG_INT}},
+    [SYS_MUNMAP] = {sys_munmap, 1, {ARG_INT}},
+#endif
+    [SYS_PRACTICE] = {sys_practice, 1, {ARG_INT}},
+    [SYS_CHDIR] = {sys_chdir, 1, {ARG_CSTR}},
+    [SYS_MKDIR] = {sys_mkdir, 1, {ARG_CSTR}},
+    [SYS_READDIR] = {sys_readdir, 2, {ARG_INT, ARG_INT}},
+    [SYS_ISDIR] = {sys_isdir, 1, {ARG_INT}},
+    [SYS_INUMBER] = {sys_inumber, 1, {ARG_INT}},
+    [SYS_HIT] = {sys_hit, 1, {ARG_INT}},
+    [SYS_MISS] = {sys_miss, 1, {ARG_INT}},
+    [SYS_RESET_CACHE] = {sys_reset_cache, 1, {ARG_INT}},
+    [SYS_WRITE_CNT] = {sys_write_cnt, 1, {ARG_INT}},
+    [SYS_PROBE_CNT] = {sys_probe_cnt, 1, {ARG_INT}},
+    [SYS_PREFETCH_CNT] = {sys_prefetch_cnt, 1, {ARG_INT}},
+    [SYS_PREFETCH_HIT] = {sys_prefetch_hit, 1, {ARG_INT}},
+    [SYS_GETDENTS] = {sys_getdents, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_PREAD] = {sys_pread, 4, {ARG_INT, ARG_WBUFFER, ARG_INT, ARG_INT}},
+    [SYS_PWRITE] = {sys_pwrite, 4, {ARG_INT, ARG_BUFFER, ARG_INT, ARG_INT}},
+    [SYS_READV] = {sys_readv, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_WRITEV] = {sys_writev, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_COPY_FILE_RANGE] = {sys_copy_file_range, 3,
+                             {ARG_INT, ARG_INT, ARG_INT}},
+#ifdef VM
+    [SYS_FORK] = {sys_fork, 0, {}},
+#endif
+    [SYS_FILE_SECTOR] = {sys_file_sector, 2, {ARG_INT, ARG_INT}},
+  };
+
+/* Looks up the system call whose number is on top of the user
+   stack, copies in all of its arguments after checking the whole
+   argument block at once, validates each one according to the
+   call's schema, and runs the handler. */
+static void
+syscall_handler (struct intr_frame *f)
+{
+  uint32_t args[SYSCALL_MAX_ARGS];
+  const struct syscall *sc;
+  uint32_t number;
+  int i;
+
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
+  ensure_valid_buffer (f, (uint32_t) f->esp, sizeof number, false);
+  number = *(uint32_t *) f->esp;
+  if (number >= sizeof syscalls / sizeof *syscalls
+      || syscalls[number].func == NULL)
     {
-      printf ("System call number: %d\n", args[0]);
+      printf ("System call number: %d\n", number);
+      return;
     }
+  sc = &syscalls[number];
+
+  ensure_valid_buffer (f, (uint32_t) f->esp + sizeof number,
+                       sc->arg_cnt * sizeof *args, false);
+  memcpy (args, (uint32_t *) f->esp + 1, sc->arg_cnt * sizeof *args);
+  for (i = 0; i < sc->arg_cnt; i++)
+    if (sc->kinds[i] == ARG_CSTR)
+      ensure_valid_cstr (f, args[i]);
+    else if (sc->kinds[i] == ARG_BUFFER || sc->kinds[i] == ARG_WBUFFER)
+      ensure_valid_buffer (f, args[i], args[i + 1],
+                           sc->kinds[i] == ARG_WBUFFER);
+
+  if (thread_current ()->current_dir == NULL)
+    thread_current ()->current_dir = dir_open_root ();
+
+  sc->func (f, args);
+#ifdef VM
+  page_unpin_all ();
+#endif
 }
@@ -0,0 +1,207 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "vm/page.h"
+
+/* Every frame in the user pool, claimed once at boot. */
+static struct frame *frames;
+static size_t frame_cnt;
+
+/* Serializes searches for a frame, and the clock hand. */
+static struct lock scan_lock;
+static size_t hand;
+
+/* Threads in frame_alloc_and_lock(), and a condition on scan_lock
+   that is signalled when a frame is unlocked while there are any. */
+static int alloc_waiter_cnt;
+static struct condition frame_released;
+
+/* Takes every page in the user pool into the frame table.  From
+   here on, user pages come from frame_alloc_and_lock() rather
+   than palloc_get_page(). */
+void
+frame_init (void)
+{
+  void *base;
+
+  lock_init (&scan_lock);
+  cond_init (&frame_released);
+
+  frames = malloc (sizeof *frames * init_ram_pages);
+  if (frames == NULL)
+    PANIC ("out of memory allocating page frames");
+
+  while ((base = palloc_get_page (PAL_USER)) != NULL)
+    {
+      struct frame *f = &frames[frame_cnt++];
+      lock_init (&f->lock);
+      f->base = base;
+      list_init (&f->pages);
+    }
+}
+
+/* Puts PAGE in frame F, which the caller holds locked. */
+static void
+add_page (struct frame *f, struct page *page)
+{
+  list_push_back (&f->pages, &page->frame_elem);
+}
+
+/* Returns true if any page in frame F, which the caller holds
+   locked, has been accessed since the last call, and clears all
+   of their accessed bits. */
+static bool
+accessed_recently (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_accessed_recently (list_entry (e, struct page, frame_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Looks for a frame to hold a new page, evicting by the clock
+   algorithm if every frame is taken: the hand sweeps the table,
+   clearing accessed bits, and stops at the first page that has not
+   been touched since its last sweep.  Returns the frame locked,
+   empty or holding its victim, or a null pointer if none is
+   available now.  In the latter case stores in *LOCKED_CNT how many
+   frames were locked during the last full sweep.  Must hold
+   scan_lock. */
+static struct frame *
+find_frame (size_t *locked_cnt)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  *locked_cnt = 0;
+
+  /* Free frame? */
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = &frames[i];
+      if (!lock_try_acquire (&f->lock))
+        continue;
+      if (list_empty (&f->pages))
+        return f;
+      lock_release (&f->lock);
+    }
+
+  /* No free frame.  Two sweeps are enough to clear every accessed
+     bit and come back round to a victim. */
+  for (i = 0; i < frame_cnt * 2; i++)
+    {
+      struct frame *f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+
+      if (!lock_try_acquire (&f->lock))
+        {
+          if (i >= frame_cnt)
+            ++*locked_cnt;
+          continue;
+        }
+      if (list_empty (&f->pages) || !accessed_recently (f))
+        return f;
+      lock_release (&f->lock);
+    }
+  return NULL;
+}
+
+/* Unlocks frame F and wakes any thread waiting in
+   frame_alloc_and_lock() for a frame to come free. */
+static void
+release_frame (struct frame *f)
+{
+  lock_release (&f->lock);
+  if (alloc_waiter_cnt > 0)
+    {
+      lock_acquire (&scan_lock);
+      cond_broadcast (&frame_released, &scan_lock);
+      lock_release (&scan_lock);
+    }
+}
+
+/* Finds a frame for PAGE, evicting another page if every frame is
+   taken, and returns it locked.  While frames that could be evicted
+   are locked for the moment, for instance pinned by system calls or
+   being read in, waits for one of them to be released and looks
+   again.  Returns a null pointer if a full sweep finds every frame
+   locked, or if the victim's contents could not be saved. */
+struct frame *
+frame_alloc_and_lock (struct page *page)
+{
+  struct frame *f;
+  size_t locked_cnt;
+
+  lock_acquire (&scan_lock);
+  alloc_waiter_cnt++;
+  while ((f = find_frame (&locked_cnt)) == NULL)
+    {
+      if (locked_cnt == frame_cnt)
+        break;
+      if (locked_cnt > 0)
+        cond_wait (&frame_released, &scan_lock);
+    }
+  alloc_waiter_cnt--;
+  lock_release (&scan_lock);
+  if (f == NULL)
+    return NULL;
+
+  /* Evict the victim, if any. */
+  if (!list_empty (&f->pages) && !page_out (f))
+    {
+      release_frame (f);
+      return NULL;
+    }
+  add_page (f, page);
+  return f;
+}
+
+/* Locks PAGE's frame into memory, if it has one.  On return,
+   PAGE's frame is either null or locked by the caller. */
+void
+frame_lock (struct page *p)
+{
+  /* A frame can be asynchronously removed, but never inserted. */
+  struct frame *f = p->frame;
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f != p->frame)
+        {
+          release_frame (f);
+          ASSERT (p->frame == NULL);
+        }
+    }
+}
+
+/* Unlocks frame F, making it available for eviction again. */
+void
+frame_unlock (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  release_frame (f);
+}
+
+/* Takes page P out of its frame, which the caller must hold
+   locked, and unlocks the frame.  The frame is free for another
+   page once no page is left in it. */
+void
+frame_free (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  list_remove (&p->frame_elem);
+  p->frame = NULL;
+  release_frame (f);
+}
@@ -0,0 +1,33 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "threads/synch.h"
+
+struct page;
+
+/* A physical frame from the user pool.  Every user page that is
+   in memory lives in one of these. */
+struct frame
+  {
+    struct lock lock;           /* Held while in use; see below. */
+    void *base;                 /* Kernel virtual base address. */
+    struct list pages;          /* Pages in this frame, if any. */
+  };
+
+/* A frame's lock is held by whoever is filling, emptying, or
+   pinning it.  The evictor only try-acquires it, so a locked frame
+   is never chosen as a victim.
+
+   A frame holds more than one page only after fork(), while parent
+   and child share it copy-on-write. */
+
+void frame_init (void);
+
+struct frame *frame_alloc_and_lock (struct page *);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_free (struct page *);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,116 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* A file mapped into a process's address space by mmap(). */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's mappings. */
+    int mapid;                  /* Mapping id. */
+    struct file *file;          /* The file, reopened for the mapping. */
+    uint8_t *base;              /* Start of mapped memory. */
+    size_t page_cnt;            /* Number of pages mapped. */
+  };
+
+/* Removes M's pages, writing back those that were modified, and
+   frees M. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  list_remove (&m->elem);
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
+
+/* Maps all of FILE at ADDR in the current process.  The mapping
+   takes ownership of FILE, which should be a private reopening.
+   Pages are read in on first access and written back only if
+   modified.  Returns the new mapping's id, or -1 if ADDR is null
+   or not page-aligned, FILE is empty, or the mapping would overlap
+   memory already in use; FILE is closed on failure. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length = file_length (file);
+  off_t ofs;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || length == 0)
+    goto fail;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    goto fail;
+  m->mapid = t->next_mapid++;
+  m->file = file;
+  m->base = addr;
+  m->page_cnt = 0;
+  list_push_back (&t->mappings, &m->elem);
+
+  for (ofs = 0; ofs < length; ofs += PGSIZE)
+    {
+      uint8_t *upage = m->base + ofs;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!is_user_vaddr (upage) || page_lookup (upage) != NULL
+          || !page_add_mmap (upage, file, ofs, read_bytes))
+        {
+          unmap (m);
+          return -1;
+        }
+      m->page_cnt++;
+    }
+  return m->mapid;
+
+ fail:
+  file_close (file);
+  return -1;
+}
+
+/* Returns the current process's mapping with id MAPID, or a null
+   pointer if there is none. */
+static struct mapping *
+lookup_mapping (int mapid)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->mapid == mapid)
+        return m;
+    }
+  return NULL;
+}
+
+/* Unmaps the current process's mapping MAPID, if it exists. */
+void
+mmap_unmap (int mapid)
+{
+  struct mapping *m = lookup_mapping (mapid);
+  if (m != NULL)
+    unmap (m);
+}
+
+/* Unmaps all of the current process's mappings.  Called when the
+   process exits. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
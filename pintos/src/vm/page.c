@@ -0,0 +1,512 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Most pages a process's stack may grow to.  Set by -stk. */
+size_t stack_max_pages = STACK_MAX_PAGES;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns false if memory is exhausted. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees one page table entry along with its frame and swap slot.
+   The mapping is cleared first so that pagedir_destroy() does not
+   also free the frame's memory. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (p->thread->pagedir, p->upage);
+      frame_free (p);
+    }
+  swap_discard (p);
+  free (p);
+}
+
+/* Frees all of the entries in PAGES, which must be the current
+   process's page table.  Its page directory must still be
+   installed, since the evictor may be looking at it until each
+   page's frame is released. */
+void
+page_table_destroy (struct hash *pages)
+{
+  page_unpin_all ();
+  hash_destroy (pages, page_destroy);
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Adds a page at UPAGE to the current process's page table, to be
+   filled with READ_BYTES bytes of FILE starting at offset OFS and
+   zeros after that on first access.  If PRIVATE, changes to the
+   page go to swap; otherwise they are written back to FILE.
+   Returns the new page, or a null pointer if UPAGE is already in
+   the page table or memory is exhausted. */
+static struct page *
+add_page (void *upage, struct file *file, off_t ofs, size_t read_bytes,
+          bool writable, bool private)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->private = private;
+  p->thread = thread_current ();
+  p->frame = NULL;
+  p->sector = (block_sector_t) -1;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a private copy of a page of FILE at UPAGE to the current
+   process's page table, as for a segment of an executable.  See
+   add_page() for the arguments.  FILE must stay open for as long
+   as the page may be loaded. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  return add_page (upage, file, ofs, read_bytes, writable, true) != NULL;
+}
+
+/* Adds a writable page at UPAGE that maps READ_BYTES bytes of
+   FILE from offset OFS, as for mmap().  Changes are written back
+   to FILE when the page is evicted or removed.  FILE must stay
+   open until the page is removed. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  return add_page (upage, file, ofs, read_bytes, true, false) != NULL;
+}
+
+/* Adds a page at UPAGE, zeroed on first access, to the current
+   process's page table.
+   Returns false if UPAGE is already in the page table or if
+   memory is exhausted. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return add_page (upage, NULL, 0, 0, writable, true) != NULL;
+}
+
+/* Removes the current process's page at UPAGE, writing it back to
+   its file first if it is a modified mmap() page. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      if (!p->private && pagedir_is_dirty (p->thread->pagedir, p->upage))
+        file_write_at (p->file, p->frame->base, p->read_bytes, p->file_ofs);
+      pagedir_clear_page (p->thread->pagedir, p->upage);
+      frame_free (p);
+    }
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  swap_discard (p);
+  free (p);
+}
+
+/* Returns the current process's page containing ADDR, or a null
+   pointer if there is none. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (addr);
+  e = hash_find (&thread_current ()->pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Returns the current process's page containing ADDR.  If there
+   is none but ADDR looks like an access to the stack, one that is
+   within the stack limit and at most 32 bytes below the user stack
+   pointer (as PUSHA may fault), the stack is grown to cover it.
+   Returns a null pointer otherwise. */
+static struct page *
+find_page (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  const uint8_t *esp = thread_current ()->user_esp;
+
+  if (p == NULL
+      && is_user_vaddr (addr)
+      && ((uintptr_t) PHYS_BASE - (uintptr_t) addr - 1) / PGSIZE
+         < stack_max_pages
+      && (const uint8_t *) addr >= esp - 32
+      && page_add_zero (pg_round_down (addr), true))
+    p = page_lookup (addr);
+  return p;
+}
+
+/* Gives page P, which has no frame, a frame and fills it
+   from swap, from its file, or with zeros.  Returns true if
+   successful, leaving the new frame locked. */
+static bool
+do_page_in (struct page *p)
+{
+  p->frame = frame_alloc_and_lock (p);
+  if (p->frame == NULL)
+    return false;
+
+  if (p->sector != (block_sector_t) -1)
+    swap_in (p);
+  else if (p->file != NULL)
+    {
+      uint8_t *kpage = p->frame->base;
+      if (file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_free (p);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+  else
+    memset (p->frame->base, 0, PGSIZE);
+  return true;
+}
+
+/* Maps page P to its frame, which the caller must hold locked.
+   A page sharing its frame copy-on-write is mapped read-only, even
+   if it is writable, so that page_unshare() sees the first write.
+   Returns false if memory for the page table is exhausted. */
+static bool
+map_page (struct page *p)
+{
+  bool shared = list_size (&p->frame->pages) > 1;
+  return pagedir_set_page (p->thread->pagedir, p->upage, p->frame->base,
+                           p->writable && !shared);
+}
+
+/* Brings page P into memory, if it is not already, and maps it.
+   Returns true with P's frame locked if successful. */
+static bool
+page_in_and_lock (struct page *p)
+{
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      if (!do_page_in (p))
+        return false;
+      if (!map_page (p))
+        {
+          frame_free (p);
+          return false;
+        }
+    }
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  return true;
+}
+
+/* Brings the current process's page containing ADDR into memory
+   and maps it, growing the stack if need be.
+   Returns true if the page is now mapped, false if ADDR is not in
+   the page table or no frame could be found for it. */
+bool
+page_load (const void *addr)
+{
+  struct page *p = find_page (addr);
+
+  if (p == NULL || !page_in_and_lock (p))
+    return false;
+  frame_unlock (p->frame);
+  return true;
+}
+
+/* Brings the current process's page containing ADDR into memory
+   and keeps it there until page_unpin_all(), so that a system
+   call can touch it without faulting while it holds file system
+   locks.  If WRITE, the call is going to write to the page.
+   Returns false if ADDR is not in the page table, if WRITE but the
+   page is read-only, or if no frame could be found for it. */
+bool
+page_pin (const void *addr, bool write)
+{
+  struct page *p = find_page (addr);
+
+  if (p == NULL || (write && !p->writable))
+    return false;
+  if (p->frame != NULL && lock_held_by_current_thread (&p->frame->lock))
+    return true;
+  if (!page_in_and_lock (p))
+    return false;
+  list_push_back (&thread_current ()->pinned, &p->pin_elem);
+  return true;
+}
+
+/* Releases every page the current process has pinned. */
+void
+page_unpin_all (void)
+{
+  struct list *pinned = &thread_current ()->pinned;
+
+  while (!list_empty (pinned))
+    {
+      struct list_elem *e = list_pop_front (pinned);
+      frame_unlock (list_entry (e, struct page, pin_elem)->frame);
+    }
+}
+
+/* Gives the current process's page containing ADDR a frame of its
+   own after a write fault on it, copying the frame it has been
+   sharing copy-on-write since fork().  A page whose sharers have
+   all gone just has its mapping made writable.  Returns false if
+   the page is not writable or no frame could be found for it. */
+bool
+page_unshare (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  struct frame *shared;
+  bool pinned;
+  bool success;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  /* A system call may be writing to a page it has pinned. */
+  pinned = (p->frame != NULL
+            && lock_held_by_current_thread (&p->frame->lock));
+  if (!pinned)
+    frame_lock (p);
+
+  /* Evicted since the fault; retrying will bring it back in with
+     a frame of its own. */
+  if (p->frame == NULL)
+    return true;
+
+  pagedir_clear_page (p->thread->pagedir, p->upage);
+  shared = p->frame;
+  if (list_size (&shared->pages) > 1)
+    {
+      /* The new frame comes back locked, which also carries over a
+         pin on the shared one. */
+      list_remove (&p->frame_elem);
+      p->frame = frame_alloc_and_lock (p);
+      if (p->frame == NULL)
+        {
+          p->frame = shared;
+          list_push_back (&shared->pages, &p->frame_elem);
+          map_page (p);
+          if (!pinned)
+            frame_unlock (shared);
+          return false;
+        }
+      memcpy (p->frame->base, shared->base, PGSIZE);
+      frame_unlock (shared);
+    }
+
+  success = map_page (p);
+  if (!pinned)
+    frame_unlock (p->frame);
+  return success;
+}
+
+/* Copies PARENT's page table into the current process's, for
+   fork().  Memory is shared copy-on-write: a page in a frame is
+   mapped read-only into both processes, a swapped-out page shares
+   its swap slot, and a page not yet loaded is only described.
+   mmap() pages are not inherited.  PARENT must stay blocked, with
+   nothing pinned, until this returns.
+   Returns false if memory is exhausted. */
+bool
+page_table_fork (struct thread *parent)
+{
+  struct file *exec = thread_current ()->executable;
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct frame *f;
+      struct page *p;
+      bool success = true;
+
+      if (!pp->private)
+        continue;
+      p = add_page (pp->upage, NULL, pp->file_ofs, pp->read_bytes,
+                    pp->writable, true);
+      if (p == NULL)
+        return false;
+
+      frame_lock (pp);
+      f = pp->frame;
+      if (f != NULL)
+        {
+          /* A page changed since it was loaded no longer matches
+             its file or swap slot, and its dirty bit is about to be
+             lost.  A clean page shares its slot with the child, so
+             that the frame's pages stay alike. */
+          if (pagedir_is_dirty (parent->pagedir, pp->upage))
+            {
+              pp->file = NULL;
+              swap_discard (pp);
+            }
+          else if (pp->sector != (block_sector_t) -1)
+            swap_share (p, pp);
+          list_push_back (&f->pages, &p->frame_elem);
+          p->frame = f;
+
+          /* Take write access away from the parent, unless an
+             earlier fork() already did. */
+          if (pp->writable && list_size (&f->pages) == 2)
+            {
+              bool accessed = pagedir_is_accessed (parent->pagedir,
+                                                   pp->upage);
+              pagedir_clear_page (parent->pagedir, pp->upage);
+              success = map_page (pp);
+              pagedir_set_accessed (parent->pagedir, pp->upage, accessed);
+            }
+          success = success && map_page (p);
+        }
+      else if (pp->sector != (block_sector_t) -1)
+        swap_share (p, pp);
+      p->file = pp->file != NULL ? exec : NULL;
+      if (f != NULL)
+        frame_unlock (f);
+      if (!success)
+        return false;
+    }
+  return true;
+}
+
+/* Evicts the pages in frame F, which the caller must hold locked.
+   Pages that still match their swap slot or their file are simply
+   dropped, and a modified mmap() page is written back to its file.
+   Anything else is written to a new swap slot, once for all of the
+   pages sharing F.
+   Returns true if F is now empty, false if its contents could not
+   be saved, in which case its pages are mapped again. */
+bool
+page_out (struct frame *f)
+{
+  struct page *p = list_entry (list_front (&f->pages), struct page,
+                               frame_elem);
+  struct list_elem *e;
+  bool dirty = false;
+  bool slot_valid;
+  bool swapped = false;
+  bool success = true;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  /* Unmap first, so that the owners fault, and wait on the frame's
+     lock, rather than writing to the page while we copy it out. */
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *q = list_entry (e, struct page, frame_elem);
+      pagedir_clear_page (q->thread->pagedir, q->upage);
+      if (pagedir_is_dirty (q->thread->pagedir, q->upage))
+        dirty = true;
+    }
+
+  /* Pages sharing a frame are all private and agree on whether
+     they still match a file or swap slot, so P speaks for all of
+     them.  A slot is stale once the page has been written. */
+  slot_valid = p->sector != (block_sector_t) -1 && !dirty;
+  if (!slot_valid && (p->file == NULL || (dirty && p->private)))
+    {
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        swap_discard (list_entry (e, struct page, frame_elem));
+      success = swapped = swap_out (f);
+    }
+  else if (dirty)
+    success = (file_write_at (p->file, f->base, p->read_bytes,
+                              p->file_ofs) == (off_t) p->read_bytes);
+
+  if (!success)
+    {
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *q = list_entry (e, struct page, frame_elem);
+          map_page (q);
+          pagedir_set_dirty (q->thread->pagedir, q->upage, dirty);
+        }
+      return false;
+    }
+
+  while (!list_empty (&f->pages))
+    {
+      struct page *q = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      if (swapped)
+        q->file = NULL;
+      q->frame = NULL;
+    }
+  return true;
+}
+
+/* Returns true if page P has been accessed since the last call,
+   and clears its accessed bit.  P's frame must be locked. */
+bool
+page_accessed_recently (struct page *p)
+{
+  bool accessed;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  accessed = pagedir_is_accessed (p->thread->pagedir, p->upage);
+  if (accessed)
+    pagedir_set_accessed (p->thread->pagedir, p->upage, false);
+  return accessed;
+}
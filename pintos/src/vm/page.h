@@ -0,0 +1,71 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+struct file;
+struct frame;
+struct thread;
+
+/* Default limit on the size of a process's stack, in pages. */
+#define STACK_MAX_PAGES 2048            /* 8 MB. */
+extern size_t stack_max_pages;
+
+/* A page of a process's virtual address space that the process
+   may touch, whether or not it is in memory.  Each process keeps
+   these in its supplemental page table, keyed by address, so that
+   page_fault() knows how to bring a page back in. */
+struct page
+  {
+    struct hash_elem hash_elem;         /* Element in thread's pages. */
+    void *upage;                        /* User virtual address. */
+    bool writable;                      /* Writable by the process? */
+    bool private;                       /* False for mmap(): write back. */
+    struct thread *thread;              /* Owning process. */
+
+    /* Set only by the owner, or by the evictor while it holds the
+       frame's lock. */
+    struct frame *frame;                /* Frame, or null. */
+    block_sector_t sector;              /* Swap slot, or -1. */
+
+    /* Contents when neither in a frame nor in swap: READ_BYTES
+       bytes of FILE from FILE_OFS, then zeros to the end of the
+       page.  FILE is null for a page that starts out all zeros,
+       and for a private page that has been written and so lives
+       in swap when evicted.  A page read back in from swap keeps
+       its slot until it is written again, so that it can be
+       dropped without writing it out. */
+    struct file *file;
+    off_t file_ofs;
+    size_t read_bytes;
+
+    struct list_elem frame_elem;        /* Element in frame's pages. */
+    struct list_elem pin_elem;          /* Element in thread's pinned. */
+  };
+
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+bool page_add_zero (void *upage, bool writable);
+void page_remove (void *upage);
+struct page *page_lookup (const void *addr);
+bool page_load (const void *addr);
+
+bool page_pin (const void *addr, bool write);
+void page_unpin_all (void);
+
+bool page_unshare (const void *addr);
+bool page_table_fork (struct thread *parent);
+
+bool page_out (struct frame *);
+bool page_accessed_recently (struct page *);
+
+#endif /* vm/page.h */
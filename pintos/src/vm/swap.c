@@ -0,0 +1,126 @@
+#include "vm/swap.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* The swap device, or a null pointer if there is none. */
+static struct block *swap_device;
+
+/* Number of pages referring to each swap slot; a slot is free
+   when its count is 0.  Slot I covers sectors
+   [I * PAGE_SECTORS, (I + 1) * PAGE_SECTORS).  More than one page
+   refers to a slot when a frame shared after fork() is swapped
+   out, or a swapped-out page is forked. */
+static unsigned *swap_refs;
+static size_t slot_cnt;
+
+/* Protects swap_refs. */
+static struct lock swap_lock;
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Sets up swap on the BLOCK_SWAP device.  Without one, nothing
+   can be swapped out, but clean file-backed pages can still be
+   evicted. */
+void
+swap_init (void)
+{
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    printf ("no swap device--swap disabled\n");
+  else
+    {
+      slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+      swap_refs = calloc (slot_cnt, sizeof *swap_refs);
+      if (swap_refs == NULL)
+        PANIC ("couldn't allocate swap slot table");
+    }
+  lock_init (&swap_lock);
+}
+
+/* Reads page P, which must be swapped out and have a locked
+   frame, back into its frame.  P keeps its reference to its swap
+   slot, which stays a valid copy of the page until it is written,
+   so that page_out() can evict the page again without I/O. */
+void
+swap_in (struct page *p)
+{
+  size_t i;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  ASSERT (p->sector != (block_sector_t) -1);
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_read (swap_device, p->sector + i,
+                (uint8_t *) p->frame->base + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes frame F, which the caller must hold locked, to a free
+   swap slot and points every page in F at the slot.
+   Returns true if successful, false if swap is full. */
+bool
+swap_out (struct frame *f)
+{
+  block_sector_t sector;
+  struct list_elem *e;
+  size_t slot;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (!list_empty (&f->pages));
+
+  lock_acquire (&swap_lock);
+  for (slot = 0; slot < slot_cnt; slot++)
+    if (swap_refs[slot] == 0)
+      {
+        swap_refs[slot] = list_size (&f->pages);
+        break;
+      }
+  lock_release (&swap_lock);
+  if (slot == slot_cnt)
+    return false;
+
+  sector = slot * PAGE_SECTORS;
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, sector + i,
+                 (uint8_t *) f->base + i * BLOCK_SECTOR_SIZE);
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    list_entry (e, struct page, frame_elem)->sector = sector;
+  return true;
+}
+
+/* Points page DST at the swap slot of SRC, which must have one. */
+void
+swap_share (struct page *dst, const struct page *src)
+{
+  ASSERT (src->sector != (block_sector_t) -1);
+
+  lock_acquire (&swap_lock);
+  swap_refs[src->sector / PAGE_SECTORS]++;
+  lock_release (&swap_lock);
+  dst->sector = src->sector;
+}
+
+/* Drops page P's reference to its swap slot, if it has one.  The
+   slot is freed along with its last reference. */
+void
+swap_discard (struct page *p)
+{
+  if (p->sector == (block_sector_t) -1)
+    return;
+
+  lock_acquire (&swap_lock);
+  swap_refs[p->sector / PAGE_SECTORS]--;
+  lock_release (&swap_lock);
+  p->sector = (block_sector_t) -1;
+}
@@ -0,0 +1,15 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+
+struct frame;
+struct page;
+
+void swap_init (void);
+void swap_in (struct page *);
+bool swap_out (struct frame *);
+void swap_share (struct page *dst, const struct page *src);
+void swap_discard (struct page *);
+
+#endif /* vm/swap.h */